@@ -21,8 +21,11 @@ struct ArgConfig {
     std::string xls_search_path;
     std::vector<std::string> yaml_search_paths;
     std::string output_base_path;
+    std::string snapshot_dir;
     bool quiet;
     bool no_cache;
+    bool no_mmap;
+    bool skip_verified;
     int tz_seconds;
     int jobs;
     std::vector<std::string> targets;
@@ -36,6 +39,8 @@ struct ArgConfig {
               output_base_path("."),
               quiet(false),
               no_cache(false),
+              no_mmap(false),
+              skip_verified(false),
               tz_seconds(utils::dateutil::local_tz_seconds()),
               jobs(std::thread::hardware_concurrency()) {
         name = argc > 0 ? argv[0] : "";
@@ -57,6 +62,9 @@ struct ArgConfig {
                 } else if (arg == "--output_base_path" && !last) {
                     output_base_path = *++it;
                     continue;
+                } else if (arg == "--snapshot_dir" && !last) {
+                    snapshot_dir = *++it;
+                    continue;
                 } else if (arg == "--jobs" && !last) {
                     auto s = *++it;
                     if (s == "full") {
@@ -77,6 +85,12 @@ struct ArgConfig {
                 } else if (arg == "--no_cache") {
                     no_cache = true;
                     continue;
+                } else if (arg == "--no_mmap") {
+                    no_mmap = true;
+                    continue;
+                } else if (arg == "--skip_verified") {
+                    skip_verified = true;
+                    continue;
                 } else if (arg == "--timezone" && !last) {
                     auto s = *++it;
                     bool ok; int h, m; size_t p;
@@ -93,6 +107,10 @@ struct ArgConfig {
                 targets.push_back(arg);
             }
         }
+        if (skip_verified && snapshot_dir.empty()) {
+            // the record of verified entries is kept in the snapshot dir.
+            throw EXCEPTION("--skip_verified: requires --snapshot_dir.");
+        }
     }
 
     inline static
@@ -105,10 +123,13 @@ struct ArgConfig {
             "xlsxconverter (rev."  << BUILD_REVISION << ")" << std::endl <<
             usage  << " [--quiet]" << std::endl <<
             indent << " [--no_cache]" << std::endl <<
+            indent << " [--no_mmap]" << std::endl <<
             indent << " [--jobs <'full'|'half'|'quarter'|int>]" << std::endl <<
             indent << " [--xls_search_path <path>]" << std::endl <<
             indent << " [--yaml_search_path <paths>]" << std::endl <<
             indent << " [--output_base_path <path>]" << std::endl <<
+            indent << " [--snapshot_dir <path>]" << std::endl <<
+            indent << " [--skip_verified]" << std::endl <<
             indent << " [--timezone <tz>]" << std::endl <<
             indent << " [<target_yaml> ...]" << std::endl <<
             "";
@@ -2,6 +2,7 @@
 // Released under the MIT license
 #pragma once
 #include <iostream>
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <unordered_set>
@@ -16,6 +17,7 @@
 
 #include "handlers.hpp"
 #include "validator.hpp"
+#include "predicate.hpp"
 
 #define EXCEPTION XLSXCONVERTER_UTILS_EXCEPTION
 
@@ -42,6 +44,8 @@ struct Converter {
     YamlConfig& yaml_config;
     bool ignore_relation = false;
     bool using_cache = false;
+    // row number of column names in the book being read. (yaml_config.row, or of the range)
+    int target_row = 0;
     std::vector<boost::optional<Validator>> validators;
     std::vector<boost::optional<handlers::RelationMap&>> relations;
 
@@ -68,12 +72,35 @@ struct Converter {
     }
 
     static inline
-    std::shared_ptr<xlsx::Workbook> open_workbook(const std::string& path, bool using_cache) {
+    std::shared_ptr<xlsx::Workbook> open_workbook(const std::string& path, bool using_cache,
+                                                  const xlsx::Workbook::Options& options) {
         if (!using_cache) {
-            return std::make_shared<xlsx::Workbook>(path);
+            return std::make_shared<xlsx::Workbook>(path, options);
         }
         static utils::shared_cache<std::string, xlsx::Workbook> cache;
-        return cache.get_or_emplace(path, path);
+        return cache.get_or_emplace(path, path, options);
+    }
+
+    inline
+    xlsx::Workbook::Options workbook_options() {
+        xlsx::Workbook::Options options;
+        options.mmap = !yaml_config.arg_config.no_mmap;
+        options.decode_threads = yaml_config.arg_config.jobs;
+        options.snapshot_dir = yaml_config.arg_config.snapshot_dir;
+        options.skip_verified = yaml_config.arg_config.skip_verified;
+        options.delimiter = yaml_config.target_delimiter;
+        if (!options.snapshot_dir.empty()) {
+            // a valid snapshot needs neither the sheet entry nor the strings.
+            options.lazy = true;
+        } else if (using_cache) {
+            // the sheet is buffered anyway. inflate it while sharedStrings is parsed.
+            options.prefetch_sheet = yaml_config.target_sheet_name;
+        } else {
+            // only this yaml reads the book. it may never need the strings and styles,
+            // e.g. numeric key/column fields of a relation.
+            options.lazy = true;
+        }
+        return options;
     }
 
     template<class T>
@@ -87,14 +114,25 @@ struct Converter {
         }
 
         handler.begin();
-        for (int i = 0; i < paths.size(); ++i) {
+        for (size_t i = 0; i < paths.size(); ++i) {
             auto xls_path = paths[i];
             try {
-                auto book = open_workbook(xls_path, using_cache);
-                auto& sheet = book->sheet_by_name(yaml_config.target_sheet_name);
-                auto column_mapping = map_column(sheet, xls_path);
-                // process data
-                handle(handler, sheet, column_mapping);
+                auto book = open_workbook(xls_path, using_cache, workbook_options());
+                auto range = book->range_by_name(yaml_config.target_sheet_name,
+                                                 yaml_config.target_range);
+                resolve_row(handler, range);
+                // a snapshot is of a whole sheet, so it is buffered to make one.
+                bool buffered = using_cache || !streamable(handler) ||
+                                !yaml_config.arg_config.snapshot_dir.empty();
+                if (buffered) {
+                    auto& sheet = book->sheet_by_name(yaml_config.target_sheet_name, range);
+                    auto column_mapping = map_column(sheet, xls_path);
+                    // process data
+                    handle(handler, sheet, column_mapping);
+                } else {
+                    // the book is not shared. process rows without buffering the sheet.
+                    stream(handler, *book, xls_path, range);
+                }
             } catch (utils::exception& exc) {
                 throw EXCEPTION("yaml=", yaml_config.path,
                                 ": xls=", xls_path,
@@ -105,15 +143,46 @@ struct Converter {
         handler.end();
     }
 
+    // cells out of the range are never read, so the column names must be in it,
+    // and the comment row too.
+    template<class T>
+    void resolve_row(T& handler, const xlsx::CellRange& range) {
+        target_row = yaml_config.row != 0 ? yaml_config.row : range.first_row + 1;
+        if (range.whole()) return;
+        if (!range.contains_row(target_row - 1)) {
+            throw EXCEPTION(yaml_config.path, ": row=", target_row, " is out of range=",
+                            range.ref());
+        }
+        auto& comment_row = handler.handler_config.comment_row;
+        if (comment_row != boost::none && !range.contains_row(comment_row.value() - 1)) {
+            throw EXCEPTION(yaml_config.path, ": comment_row=", comment_row.value(),
+                            " is out of range=", range.ref());
+        }
+    }
+
+    template<class T>
+    bool streamable(T& handler) {
+        // comment row must be read before the first data row.
+        auto& comment_row = handler.handler_config.comment_row;
+        return comment_row == boost::none || comment_row.value() <= target_row;
+    }
+
     inline
     std::vector<int> map_column(xlsx::Sheet& sheet, std::string& xls_path) {
+        auto row = sheet.row(target_row - 1);
+        return map_column([&](int i) -> xlsx::Cell { return row.cell(i); },
+                          sheet.ncols(), xls_path);
+    }
+
+    template<class F>
+    std::vector<int> map_column(F cell_at, int ncols, std::string& xls_path) {
         std::vector<int> column_mapping;
-        for (int k = 0; k < yaml_config.fields.size(); ++k) {
+        for (size_t k = 0; k < yaml_config.fields.size(); ++k) {
             auto& field = yaml_config.fields[k];
             bool found = false;
-            for (int i = 0; i < sheet.ncols(); ++i) {;
-                auto& cell = sheet.cell(yaml_config.row - 1, i);
-                if (cell.as_str() == field.name) {
+            for (int i = 0; i < ncols; ++i) {;
+                auto&& cell = cell_at(i);
+                if (cell.text() == field.name) {
                     column_mapping.push_back(i);
                     found = true;
                     break;
@@ -124,11 +193,11 @@ struct Converter {
                     column_mapping.push_back(-1);
                     continue;
                 }
-                for (int i = 0; i < sheet.ncols(); ++i) {
-                    auto& cell = sheet.cell(yaml_config.row-1, i);
+                for (int i = 0; i < ncols; ++i) {
+                    auto&& cell = cell_at(i);
                     utils::log("cell[", cell.cellname(), "]=", cell.as_str());
                 }
-                throw EXCEPTION(yaml_config.path, ": ", xls_path, ": row=", yaml_config.row,
+                throw EXCEPTION(yaml_config.path, ": ", xls_path, ": row=", target_row,
                                 ": field{column=", field.column,
                                 ",name=", field.name, "}: NOT exists.");
             }
@@ -139,81 +208,167 @@ struct Converter {
     template<class T>
     void handle(T& handler, xlsx::Sheet& sheet, std::vector<int>& column_mapping) {
         if (handler.handler_config.comment_row != boost::none) {
-            int row = handler.handler_config.comment_row.value() - 1;
-            handler.begin_comment_row();
-            for (int k = 0; k < column_mapping.size(); ++k) {
-                auto& field = yaml_config.fields[k];
-                if (field.type == YamlConfig::Field::Type::kIsIgnored) continue;
-                auto i = column_mapping[k];
-                if (i == -1) {
-                    handler.field(field, std::string());
-                } else {
-                    auto& cell = sheet.cell(row, i);
-                    handler.field(field, cell.as_str());
-                }
+            auto row = sheet.row(handler.handler_config.comment_row.value() - 1);
+            handle_comment_row(handler, column_mapping,
+                               [&](int i) -> xlsx::Cell { return row.cell(i); });
+        }
+        auto header = sheet.row(target_row - 1);
+        auto predicate = compile_where([&](int i) -> xlsx::Cell { return header.cell(i); },
+                                       sheet.ncols(), column_mapping);
+        // the other rows are empty lines in the mapped columns, and need no cell.
+        auto rows = sheet.row_indexes(column_mapping);
+        for (auto it = std::lower_bound(rows.begin(), rows.end(), target_row);
+             it != rows.end(); ++it) {
+            int j = *it;
+            auto row = sheet.row(j);
+            // the cells of where first. a rejected row reads no other cell.
+            if (predicate != boost::none &&
+                !predicate.value()([&](int i) -> xlsx::Cell { return row.cell(i); })) {
+                continue;
             }
-            handler.end_comment_row();
+            handle_row(handler, j, column_mapping,
+                       [&](int i) -> xlsx::Cell { return row.cell(i); });
         }
-        for (int j = yaml_config.row; j < sheet.nrows(); ++j) {
-            bool is_empty_line = true;
-            bool is_ignored = false;
-            for (int k = 0; k < column_mapping.size(); ++k) {
-                using CT = xlsx::Cell::Type;
-                auto& field = yaml_config.fields[k];
-                auto i = column_mapping[k];
-                auto& cell = sheet.cell(j, i);
-                if (i == -1) continue;
-                if (cell.type != CT::kEmpty) {
-                    is_empty_line = false;
-                }
-                if (field.type == YamlConfig::Field::Type::kIsIgnored) {
-                    if (cell.type == CT::kBool) {
-                        is_ignored = cell.as_bool();
-                    }
-                    if (cell.type == CT::kInt || cell.type == CT::kDouble) {
-                        is_ignored = cell.as_int() != 0;
-                    }
-                    if (cell.type == CT::kString) {
-                        is_ignored = truthy(cell.as_str());
-                    }
-                    if (is_ignored) break;
-                }
+    }
+
+    template<class F>
+    boost::optional<Predicate> compile_where(F header_at, int ncols,
+                                             const std::vector<int>& column_mapping) {
+        if (yaml_config.where.empty()) return boost::none;
+        return Predicate(yaml_config, column_mapping, header_at, ncols);
+    }
+
+    template<class T>
+    void stream(T& handler, xlsx::Workbook& book, std::string& xls_path,
+                const xlsx::CellRange& range) {
+        int header_row = target_row - 1;
+        int comment_row = -1;
+        if (handler.handler_config.comment_row != boost::none) {
+            comment_row = handler.handler_config.comment_row.value() - 1;
+        }
+        xlsx::Row header;
+        xlsx::Row comment;
+        boost::optional<std::vector<int>> column_mapping;
+        xlsx::ColumnProjection projection;
+        boost::optional<Predicate> predicate;
+        // data rows are judged by the cells of where, before the others are decoded.
+        xlsx::RowFilter filter;
+        filter.first_row = target_row;
+        auto begin = [&]() {
+            auto header_at = [&](int i) -> xlsx::Cell& { return header.cell(i); };
+            column_mapping = map_column(header_at, header.cells.size(), xls_path);
+            auto colxs = column_mapping.value();
+            predicate = compile_where(header_at, header.cells.size(), colxs);
+            if (predicate != boost::none) {
+                auto columns = predicate.value().columns();
+                colxs.insert(colxs.end(), columns.begin(), columns.end());
+                filter.columns.set(columns);
+                filter.accept = [&](xlsx::Row& row) {
+                    return predicate.value()([&](int i) -> xlsx::Cell& { return row.cell(i); });
+                };
             }
-            if (is_empty_line || is_ignored) { continue; }
+            // the reader skips the other columns from the next row.
+            projection.set(colxs);
+            if (comment_row != -1) {
+                handle_comment_row(handler, column_mapping.value(),
+                                   [&](int i) -> xlsx::Cell& { return comment.cell(i); });
+            }
+        };
+        book.each_row(yaml_config.target_sheet_name, [&](xlsx::Row& row) {
+            if (row.index == header_row) header = row;
+            if (row.index == comment_row) comment = row;
+            if (row.index == header_row) begin();
+            if (row.index < target_row) return;
+            if (column_mapping == boost::none) {
+                begin();
+                // this row was read before the filter.
+                if (filter.accept && !filter.accept(row)) return;
+            }
+            // no mapped cell has a value. an empty line.
+            if (row.cells.empty()) return;
+            handle_row(handler, row.index, column_mapping.value(),
+                       [&](int i) -> xlsx::Cell& { return row.cell(i); });
+        }, &projection, range.whole() ? nullptr : &range, &filter);
+        if (column_mapping == boost::none) begin();
+    }
 
-            handler.begin_row();
-            for (int k = 0; k < column_mapping.size(); ++k) {
-                auto& field = yaml_config.fields[k];
-                if (field.type == YamlConfig::Field::Type::kIsIgnored) continue;
-                auto i = column_mapping[k];
-                if (i == -1) {;
-                    if (!field.using_default) {
-                        throw EXCEPTION("optional field requires default.");
-                    }
-                    handle_cell_default(handler, field);
-                } else {
-                    auto& cell = sheet.cell(j, i);
-                    auto& validator = validators[k];
-                    auto& relation = relations[k];
-                    try {
-                        handle_cell(handler, cell, field, validator, relation);
-                    } catch (std::exception& exc) {
-                        throw EXCEPTION("field=", field.column, ": cell[", cell.cellname(), "]=",
-                                        "{value=", cell.as_str(), ",type=", cell.type_name(), "}: ",
-                                        exc.what());
-                    }
+    template<class T, class F>
+    void handle_comment_row(T& handler, std::vector<int>& column_mapping, F cell_at) {
+        handler.begin_comment_row();
+        for (size_t k = 0; k < column_mapping.size(); ++k) {
+            auto& field = yaml_config.fields[k];
+            if (field.type == YamlConfig::Field::Type::kIsIgnored) continue;
+            auto i = column_mapping[k];
+            if (i == -1) {
+                handler.field(field, std::string());
+            } else {
+                auto&& cell = cell_at(i);
+                handler.field(field, cell.as_str());
+            }
+        }
+        handler.end_comment_row();
+    }
+
+    template<class T, class F>
+    void handle_row(T& handler, int j, std::vector<int>& column_mapping, F cell_at) {
+        bool is_empty_line = true;
+        bool is_ignored = false;
+        for (size_t k = 0; k < column_mapping.size(); ++k) {
+            using CT = xlsx::Cell::Type;
+            auto& field = yaml_config.fields[k];
+            auto i = column_mapping[k];
+            auto&& cell = cell_at(i);
+            if (i == -1) continue;
+            if (cell.type != CT::kEmpty) {
+                is_empty_line = false;
+            }
+            if (field.type == YamlConfig::Field::Type::kIsIgnored) {
+                if (cell.type == CT::kBool) {
+                    is_ignored = cell.as_bool();
+                }
+                if (cell.type == CT::kInt || cell.type == CT::kDouble) {
+                    is_ignored = cell.as_int() != 0;
                 }
+                if (cell.type == CT::kString) {
+                    is_ignored = truthy(cell.as_str());
+                }
+                if (is_ignored) break;
             }
-            try {
-                handler.end_row();
-            } catch (std::exception& exc) {
-                throw EXCEPTION("row=", j, ": ", exc.what());
+        }
+        if (is_empty_line || is_ignored) return;
+
+        handler.begin_row();
+        for (size_t k = 0; k < column_mapping.size(); ++k) {
+            auto& field = yaml_config.fields[k];
+            if (field.type == YamlConfig::Field::Type::kIsIgnored) continue;
+            auto i = column_mapping[k];
+            if (i == -1) {;
+                if (!field.using_default) {
+                    throw EXCEPTION("optional field requires default.");
+                }
+                handle_cell_default(handler, field);
+            } else {
+                auto&& cell = cell_at(i);
+                auto& validator = validators[k];
+                auto& relation = relations[k];
+                try {
+                    handle_cell(handler, cell, field, validator, relation);
+                } catch (std::exception& exc) {
+                    throw EXCEPTION("field=", field.column, ": cell[", cell.cellname(), "]=",
+                                    "{value=", cell.as_str(), ",type=", cell.type_name(), "}: ",
+                                    exc.what());
+                }
             }
         }
+        try {
+            handler.end_row();
+        } catch (std::exception& exc) {
+            throw EXCEPTION("row=", j, ": ", exc.what());
+        }
     }
 
     template<class T>
-    void handle_cell(T& handler, xlsx::Cell& cell, YamlConfig::Field& field,
+    void handle_cell(T& handler, const xlsx::Cell& cell, YamlConfig::Field& field,
                      boost::optional<Validator>& validator,
                      boost::optional<handlers::RelationMap&>& relation) {
         using FT = YamlConfig::Field::Type;
@@ -242,6 +242,10 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    if (!arg_config->snapshot_dir.empty()) {
+        utils::fs::mkdirp(arg_config->snapshot_dir);
+    }
+
     int jobs = arg_config->jobs;
     if (!arg_config->quiet) {
         utils::log("jobs: ", jobs);
@@ -265,11 +269,15 @@ int main(int argc, char** argv) {
             task.phase1_done.unlock();
             task.phase2_done.unlock();
             task.phase3_done.unlock();
-            return;
         }
         #endif
+        // this thread is free for the sheets which are still decoding.
+        xlsx::ThreadBudget::global().release(1);
     });
 
+    // each job runs on a thread of its own. parallel decoders take only the idle ones.
+    xlsx::ThreadBudget::global().limit(0);
+
     auto tasks = std::vector<std::thread>();
     for (int i = 0; i < jobs - 1; ++i) {
         tasks.emplace_back(work);
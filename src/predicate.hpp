@@ -0,0 +1,134 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <string>
+#include <vector>
+
+#include "xlsx.hpp"
+#include "yaml_config.hpp"
+#include "utils.hpp"
+
+#define EXCEPTION XLSXCONVERTER_UTILS_EXCEPTION
+
+namespace xlsxconverter {
+
+// where of a yaml, compiled against the columns of a sheet.
+// a row is judged by the cells of its columns only, before any field is read.
+struct Predicate {
+    using Op = YamlConfig::Condition::Op;
+
+    struct Value {
+        std::string text;
+        bool is_number = false;
+        double number = 0.0;
+        // 1: true, 0: false, -1: not a bool.
+        int boolean = -1;
+    };
+
+    struct Term {
+        int colx = -1;
+        Op op = Op::kEq;
+        std::vector<Value> values;
+    };
+
+    std::vector<Term> terms;
+
+    // a column of a field is the one it is mapped to. the others are found by header_at,
+    // as map_column finds the fields.
+    template<class F>
+    Predicate(const YamlConfig& yaml_config, const std::vector<int>& column_mapping,
+              F header_at, int ncols) {
+        for (auto& condition : yaml_config.where) {
+            Term term;
+            term.op = condition.op;
+            for (size_t k = 0; k < yaml_config.fields.size(); ++k) {
+                if (yaml_config.fields[k].column == condition.column) {
+                    term.colx = column_mapping[k];
+                    break;
+                }
+            }
+            for (int i = 0; term.colx == -1 && i < ncols; ++i) {
+                if (header_at(i).text() == condition.column) term.colx = i;
+            }
+            if (term.colx == -1) {
+                throw EXCEPTION(yaml_config.path, ": where: column=", condition.column,
+                                ": NOT exists.");
+            }
+            for (auto& text : condition.values) term.values.push_back(parse_value(text));
+            terms.push_back(term);
+        }
+    }
+
+    static inline
+    Value parse_value(const std::string& text) {
+        Value value;
+        value.text = text;
+        auto number = xlsx::Number::parse(text);
+        if (number.kind != xlsx::Number::Kind::kInvalid) {
+            value.is_number = true;
+            value.number = number.kind == xlsx::Number::Kind::kDouble
+                           ? number.d : static_cast<double>(number.i);
+        }
+        if (text == "true" || text == "True" || text == "TRUE") value.boolean = 1;
+        if (text == "false" || text == "False" || text == "FALSE") value.boolean = 0;
+        return value;
+    }
+
+    inline
+    std::vector<int> columns() const {
+        std::vector<int> colxs;
+        for (auto& term : terms) colxs.push_back(term.colx);
+        return colxs;
+    }
+
+    // cell_at(colx) is called only for the columns of the terms.
+    template<class F>
+    bool operator()(F cell_at) const {
+        for (auto& term : terms) {
+            if (!holds(term, cell_at(term.colx))) return false;
+        }
+        return true;
+    }
+
+    static inline
+    bool holds(const Term& term, const xlsx::Cell& cell) {
+        switch (term.op) {
+            case Op::kEq: return compare(cell, term.values[0]) == 0;
+            case Op::kNe: return compare(cell, term.values[0]) != 0;
+            case Op::kLt: return compare(cell, term.values[0]) < 0;
+            case Op::kLe: return compare(cell, term.values[0]) <= 0;
+            case Op::kGt: return compare(cell, term.values[0]) > 0;
+            case Op::kGe: return compare(cell, term.values[0]) >= 0;
+            case Op::kIn:
+            case Op::kNotIn: {
+                bool found = false;
+                for (auto& value : term.values) {
+                    if (compare(cell, value) == 0) {
+                        found = true;
+                        break;
+                    }
+                }
+                return found == (term.op == Op::kIn);
+            }
+        }
+        return false;
+    }
+
+    // numbers by their value, bools by true/false, and the others by their text.
+    static inline
+    int compare(const xlsx::Cell& cell, const Value& value) {
+        using CT = xlsx::Cell::Type;
+        bool numeric = cell.type == CT::kInt || cell.type == CT::kDouble ||
+                       cell.type == CT::kDateTime;
+        if (numeric && value.is_number) {
+            double d = cell.as_double();
+            return d < value.number ? -1 : (d > value.number ? 1 : 0);
+        }
+        if (cell.type == CT::kBool && value.boolean != -1) {
+            return static_cast<int>(cell.as_bool()) - value.boolean;
+        }
+        return cell.text().compare(xlsx::StringRef(value.text));
+    }
+};
+
+}  // namespace xlsxconverter
@@ -16,6 +16,7 @@
 #include <unordered_map>
 #include <clocale>
 #include <utility>
+#include <memory>
 #ifdef _WIN32
 #include <windows.h>
 #include <wincon.h>
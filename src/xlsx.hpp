@@ -2,54 +2,51 @@
 // Released under the MIT license
 #pragma once
 #include <sys/stat.h>
+#include <cstring>
 #include <tuple>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <exception>
 #include <utility>
 #include <random>
+#include <future>
+#include <functional>
+#include <algorithm>
 
 #include <ZipFile.h>
 #include <pugixml.hpp>
 
-namespace xlsx {
-
-template<class T>
-void sscat_detail_(std::stringstream& ss, const T& t) {
-    ss << t;
-}
-
-template<class T, class...A>
-void sscat_detail_(std::stringstream& ss, const T& t, const A&...a) {
-    ss << t;
-    sscat_detail_(ss, a...);
-}
-
-template<class...A>
-std::string sscat(const A&...a) {
-    auto ss = std::stringstream();
-    sscat_detail_(ss, a...);
-    return ss.str();
-}
-
-struct Exception: std::runtime_error {
-    template<class...A>
-    inline explicit Exception(A...a) : std::runtime_error(sscat(a...).c_str()) {}
-};
+#include "xlsx/exception.hpp"
+#include "xlsx/cell_ref.hpp"
+#include "xlsx/deferred.hpp"
+#include "xlsx/thread_budget.hpp"
+#include "xlsx/sheet_reader.hpp"
+#include "xlsx/shared_strings.hpp"
+#include "xlsx/column_store.hpp"
+#include "xlsx/number.hpp"
+#include "xlsx/zip_reader.hpp"
+#include "xlsx/entry_reader.hpp"
+#include "xlsx/csv_reader.hpp"
+#include "xlsx/snapshot.hpp"
+#include "xlsx/xlsb_reader.hpp"
 
+namespace xlsx {
 
 struct StyleSheet {
     std::vector<int> num_fmts_by_xf_index;
     std::unordered_map<int, std::string> format_codes;
 
-    std::unordered_map<int, bool> is_date_table_;
-    std::mutex mutex_;
+    // xf index -> is date. immutable after loaded, so read without locks.
+    std::vector<uint8_t> is_date_by_xf_index;
+    Deferred deferred;
     /*
     numFmts.
     # "std" == "standard for US English locale"
@@ -116,6 +113,26 @@ struct StyleSheet {
 
     inline
     explicit StyleSheet(std::unique_ptr<pugi::xml_document> doc) {
+        load(std::move(doc));
+        deferred.ensure();
+    }
+
+    // the styles are filled by loader on first use, e.g. with load() or assign().
+    inline
+    explicit StyleSheet(std::function<void(StyleSheet&)> loader) {
+        deferred.load = [this, loader]() { loader(*this); };
+    }
+
+    StyleSheet(const StyleSheet&) = delete;
+    StyleSheet& operator=(const StyleSheet&) = delete;
+
+    inline
+    bool loaded() const {
+        return deferred.ready.load(std::memory_order_acquire);
+    }
+
+    inline
+    void load(std::unique_ptr<pugi::xml_document> doc) {
         auto ss = doc->child("styleSheet");
         for (auto& nf : ss.child("numFmts").children("numFmt")) {
             int fmtid = nf.attribute("numFmtId").as_int();
@@ -126,25 +143,47 @@ struct StyleSheet {
             int fmtid = xf.attribute("numFmtId").as_int();
             num_fmts_by_xf_index.push_back(fmtid);
         }
+        build();
+    }
+
+    // number formats read from elsewhere, e.g. styles.bin of a binary workbook.
+    inline
+    void assign(std::unordered_map<int, std::string> format_codes_,
+                std::vector<int> num_fmts_by_xf_index_) {
+        format_codes = std::move(format_codes_);
+        num_fmts_by_xf_index = std::move(num_fmts_by_xf_index_);
+        build();
+    }
+
+    inline
+    void build() {
+        is_date_by_xf_index.reserve(num_fmts_by_xf_index.size());
+        for (int fmtid : num_fmts_by_xf_index) {
+            is_date_by_xf_index.push_back(is_date_fmtid(fmtid));
+        }
     }
 
     inline
     bool is_date_format(int xf_index) {
-        // SEE: https://github.com/python-excel/xlrd/blob/master/xlrd/formatting.py
-        std::lock_guard<std::mutex> lock(mutex_);
-        auto it = is_date_table_.find(xf_index);
-        if (it != is_date_table_.end()) return it->second;
+        deferred.ensure();
+        if (xf_index < 0 || is_date_by_xf_index.size() <= static_cast<size_t>(xf_index)) {
+            return false;
+        }
+        return is_date_by_xf_index[xf_index] != 0;
+    }
 
-        auto fmtid = num_fmts_by_xf_index[xf_index];
+    inline
+    bool is_date_fmtid(int fmtid) const {
+        // SEE: https://github.com/python-excel/xlrd/blob/master/xlrd/formatting.py
         // standard formats.
         if (0x0e <= fmtid && fmtid <= 0x16) return true;
         if (0x2d <= fmtid && fmtid <= 0x2f) return true;
         if (fmtid <= 0x31) return false;
         // 0-13: false, 14-22: true, 23-44: false, 45-47: true, 47-49: false
 
-        auto code = format_codes[fmtid];
+        auto it = format_codes.find(fmtid);
+        auto code = it != format_codes.end() ? it->second : std::string();
         if (non_date_formats().count(code) == 1) {
-            is_date_table_[xf_index] = false;
             return false;
         }
 
@@ -163,20 +202,16 @@ struct StyleSheet {
             }
         }
         if (date_count > 0 && num_count == 0) {
-            is_date_table_[xf_index] = true;
             return true;
         }
         if (num_count > 0 && date_count == 0) {
-            is_date_table_[xf_index] = false;
             return false;
         }
-        bool r = date_count > num_count;
-        is_date_table_[xf_index] = r;
-        return r;
+        return date_count > num_count;
     }
 
-    inline
-    std::string remove_bracketed(std::string s) {
+    static inline
+    std::string remove_bracketed(const std::string& s) {
         std::string r;
         bool in_bracket = false;
         for (auto c : s) {
@@ -201,9 +236,17 @@ struct Cell {
     };
 
     std::string v;
+    // text held elsewhere (shared string table, or the column store of Sheet).
+    // refers to it instead of copying into v.
+    StringRef ref;
     int row = -1;
     int col = -1;
     Type type = Type::kEmpty;
+    // binary value parsed once at load. kInt has both, kDouble and kDateTime have double.
+    bool has_int = false;
+    bool has_double = false;
+    int64_t int_value = 0;
+    double double_value = 0.0;
 
     inline
     Cell() : Cell(-1, -1) {}
@@ -211,38 +254,92 @@ struct Cell {
     inline
     Cell(int row, int col) : Cell(row, col, "", "", -1, nullptr, nullptr) {}
 
+    // view of a stored cell.
+    inline
+    Cell(int row, int col, Type type, StringRef ref) : ref(ref), row(row), col(col), type(type) {}
+
     inline
-    Cell(int row, int col, std::string v_, std::string t, int s,
-         std::shared_ptr<std::vector<std::string>> shared_string,
-         std::shared_ptr<StyleSheet> style_sheet)
-        : row(row), col(col), v(v_) {
-        if (v == "") {
+    Cell(int row, int col, const std::string& v_, const std::string& t, int s,
+         const std::shared_ptr<SharedStrings>& shared_string,
+         const std::shared_ptr<StyleSheet>& style_sheet)
+        : row(row), col(col) {
+        if (v_ == "") {
             type = Type::kEmpty;
-        } else if (t == "s") {
+            return;
+        }
+        if (t == "s") {
             type = Type::kString;
             if (shared_string.get() == nullptr) {
                 throw Exception("invalid shared_string: nullptr");
             }
-            int64_t i = std::stoll(v);
-            if (i < 0 || shared_string->size() <= i) {
-                throw Exception("invalid shared_string: invalid id=", i);
-            }
-            v = shared_string->at(i);
-        } else if (t == "b") {
-            type = Type::kBool;
+            ref = shared_string->at(shared_string_id(v_, shared_string->size(), row, col));
+            return;
+        }
+        v = v_;
+        auto number = Number::parse(v);
+        type = classify(v, t, s, style_sheet, number);
+        if (has_number(type, number)) set_number(number_bits(type, number));
+    }
+
+    // index into sharedStrings.xml of a t="s" cell.
+    static inline
+    size_t shared_string_id(const std::string& v, size_t size, int row, int col) {
+        auto number = Number::parse(v);
+        if (number.kind != Number::Kind::kInt || number.i < 0
+                || size <= static_cast<uint64_t>(number.i)) {
+            throw Exception("invalid shared_string: invalid id=", v,
+                            " cell=", CellRef::name(row, col));
+        }
+        return static_cast<size_t>(number.i);
+    }
+
+    // type of a cell which is not empty nor a shared string.
+    static inline
+    Type classify(const std::string& v, const std::string& t, int s,
+                  const std::shared_ptr<StyleSheet>& style_sheet, const Number& number) {
+        if (t == "inlineStr" || t == "s") return Type::kString;
+        if (t == "b") return Type::kBool;
+        if (s > 0 && style_sheet->is_date_format(s)) return Type::kDateTime;
+        if (number.kind != Number::Kind::kInvalid) {
+            return number.kind == Number::Kind::kDouble ? Type::kDouble : Type::kInt;
+        }
+        if (is_float_string(v)) return Type::kDouble;
+        return Type::kInt;
+    }
+
+    // whether the value is kept in binary. the others are read from text.
+    static inline
+    bool has_number(Type type, const Number& number) {
+        if (number.kind == Number::Kind::kInvalid) return false;
+        return type == Type::kInt || type == Type::kDouble || type == Type::kDateTime;
+    }
+
+    // int64 for kInt, double for kDouble and kDateTime.
+    static inline
+    uint64_t number_bits(Type type, const Number& number) {
+        uint64_t bits;
+        if (type == Type::kInt) {
+            std::memcpy(&bits, &number.i, sizeof(bits));
         } else {
-            if (s > 0 && style_sheet->is_date_format(s)) {
-                type = Type::kDateTime;
-            } else if (is_float_string(v)) {
-                type = Type::kDouble;
-            } else {
-                type = Type::kInt;
-            }
+            std::memcpy(&bits, &number.d, sizeof(bits));
         }
+        return bits;
     }
 
     inline
-    bool is_float_string(std::string v) {
+    void set_number(uint64_t bits) {
+        if (type == Type::kInt) {
+            std::memcpy(&int_value, &bits, sizeof(bits));
+            double_value = static_cast<double>(int_value);
+            has_int = true;
+        } else {
+            std::memcpy(&double_value, &bits, sizeof(bits));
+        }
+        has_double = true;
+    }
+
+    static inline
+    bool is_float_string(const std::string& v) {
         if (v.empty()) return false;
         auto it = v.begin();
         if (*it == '+' || *it == '-') ++it;
@@ -275,7 +372,7 @@ struct Cell {
     }
 
     inline
-    std::string type_name() {
+    std::string type_name() const {
         // for error.
         switch (type) {
             case (Type::kEmpty): return "empty";
@@ -289,7 +386,7 @@ struct Cell {
     }
 
     inline
-    std::string cellname() {
+    std::string cellname() const {
         std::string name;
         int ncol = col + 1;
         while (ncol > 0) {
@@ -305,31 +402,49 @@ struct Cell {
         return name + std::to_string(row + 1);
     }
 
+    // text of the cell, without copying.
+    inline
+    StringRef text() const {
+        return ref.data != nullptr ? ref : StringRef(v);
+    }
+
     inline
-    int64_t as_int() {
+    int64_t as_int() const {
+        if (has_int) return int_value;
+        if (has_double) {
+            // stoll reads the integer part.
+            int64_t i;
+            auto s = text();
+            if (Number::parse_int_prefix(s.begin(), s.end(), i)) return i;
+        }
         try {
-            return std::stoll(v);
+            return std::stoll(ref.data != nullptr ? ref.str() : v);
         } catch (std::invalid_argument& exc) {
             return 0;
+        } catch (std::out_of_range& exc) {
+            throw Exception("invalid int: out of range. value=", text().str(),
+                            " cell=", CellRef::name(row, col));
         }
     }
 
     inline
-    bool as_bool() {
-        return v != "0" && !v.empty();
+    bool as_bool() const {
+        auto s = text();
+        return s != StringRef("0", 1) && !s.empty();
     }
 
     inline
-    double as_double() {
+    double as_double() const {
+        if (has_double) return double_value;
         try {
-            return std::stod(v);
+            return std::stod(ref.data != nullptr ? ref.str() : v);
         } catch (std::invalid_argument& exc) {
             return 0.0;
         }
     }
 
     inline
-    int64_t as_time64(int tz_seconds = 0) {
+    int64_t as_time64(int tz_seconds = 0) const {
         // xldate is double.
         //   int-part: 1899-12-30 based days.
         //   frac-part: time seconds / (24*60*60).
@@ -351,122 +466,408 @@ struct Cell {
     }
 
     inline
-    time_t as_time(int tz_seconds = 0) {
+    time_t as_time(int tz_seconds = 0) const {
         return as_time64(tz_seconds);
     }
 
     inline
-    std::string as_str() {
-        return v;
+    std::string as_str() const {
+        return text().str();
     }
 };
 
+// cells of a row up to the last one it has.
+struct Row {
+    int index = -1;
+    std::vector<Cell> cells;
+    Cell ncell;
+
+    inline
+    Cell& cell(int colx) {
+        if (colx < 0) return ncell;
+        if (cells.size() <= static_cast<size_t>(colx)) {
+            // empty, past the last cell.
+            ncell = Cell(index, colx);
+            return ncell;
+        }
+        return cells[colx];
+    }
+};
+
+// rows to be decoded, judged by a few of their cells before the others. (streaming mode)
+struct RowFilter {
+    // cells given to accept. the other cells of a rejected row are not decoded.
+    ColumnProjection columns;
+    // none: every row is decoded.
+    std::function<bool(Row&)> accept;
+    // rows before this are not judged, e.g. a header.
+    int first_row = 0;
+};
+
 struct Sheet {
+    // ColumnStore tag of a shared string. the value is the index of the table.
+    static const uint8_t kSharedStringTag = 0x80;
+    // ColumnStore tag of a cell with a binary value. (ColumnStore::set_number)
+    static const uint8_t kNumberTag = ColumnStore::kNumberTag;
+    static const uint8_t kTypeMask = 0x1F;
+    // sheetData smaller than this is decoded on one thread.
+    static const size_t kParallelDecodeSize = 4 * 1024 * 1024;
+
     std::string rid;
     std::string name;
     std::string demension;
-    std::unique_ptr<pugi::xml_document> doc;
-    std::shared_ptr<std::vector<std::string>> shared_string;
+    std::shared_ptr<SharedStrings> shared_string;
     std::shared_ptr<StyleSheet> style_sheet;
 
     // cached
-    std::vector<pugi::xml_node> row_nodes_;
     int nrows_ = -1;
     int ncols_ = -1;
-    std::vector<std::vector<Cell>> cells_;
-    std::unique_ptr<std::vector<std::mutex>> row_locks;
+    // immutable after construction. read without locks.
+    // up to the last column which has a cell. the dimension may be far larger than the data.
+    std::vector<ColumnStore> columns;
+    // rows which have a cell, in order.
+    std::vector<int> row_indexes_;
     bool preloaded;
-
-    Cell ncell;
+    // chunks of sheetData decoded side by side. 1 for a serial decode.
+    int decoded_chunks = 1;
 
     Sheet() = default;
 
+    // buffered mode: decodes all rows from reader.
+    // a large sheetData in memory is split at <row> and decoded on nthreads.
     inline
-    Sheet(std::string rid_, std::string name_,
-          std::unique_ptr<pugi::xml_document> doc_,
-          std::shared_ptr<std::vector<std::string>> shared_string_,
+    Sheet(std::string rid_, std::string name_, SheetReader& reader,
+          std::shared_ptr<SharedStrings> shared_string_,
+          std::shared_ptr<StyleSheet> style_sheet_, int nthreads = 1)
+            : rid(rid_), name(name_),
+              shared_string(shared_string_),
+              style_sheet(style_sheet_),
+              preloaded(true) {
+        std::tie(nrows_, ncols_) = parse_dimension(reader.dimension);
+        if (nthreads > 1 && reader.in_memory() && !reader.tag.prefixed &&
+            reader.size - reader.pos >= kParallelDecodeSize) {
+            if (decode_parallel(reader, nthreads)) {
+                finish();
+                return;
+            }
+        }
+        decode(reader, columns);
+        finish();
+    }
+
+    // from the columns of a snapshot, which refer to no shared string.
+    inline
+    Sheet(std::string rid_, std::string name_, int nrows, int ncols,
+          std::vector<ColumnStore> columns_,
+          std::shared_ptr<SharedStrings> shared_string_,
           std::shared_ptr<StyleSheet> style_sheet_)
             : rid(rid_), name(name_),
-              doc(std::move(doc_)),
               shared_string(shared_string_),
               style_sheet(style_sheet_),
-              preloaded(false) {
-        auto sheet = doc->child("worksheet");
-        auto dimension = sheet.child("dimension");
-        std::string dimension_ref = dimension.attribute("ref").as_string();
-        auto p = dimension_ref.find(':');
-        if (p == std::string::npos) {
-            throw Exception("invalid demension: ", dimension_ref);
+              nrows_(nrows), ncols_(ncols),
+              columns(std::move(columns_)),
+              preloaded(true) {
+        index_rows();
+    }
+
+    // a copy of the columns with shared strings in their text, to be read without the table.
+    // columns of a mapped snapshot refer to no shared string, and share the mapping.
+    inline
+    std::vector<ColumnStore> detached_columns() const {
+        auto copies = columns;
+        for (auto& column : copies) {
+            for (size_t i = 0; i < column.tags.size(); ++i) {
+                if ((column.tags[i] & kSharedStringTag) == 0) continue;
+                auto s = shared_string->at(column.values[i]);
+                if (column.text.size() + s.size > UINT32_MAX) {
+                    throw Exception("too large column text. sheet=", name);
+                }
+                column.values[i] = (uint64_t(column.text.size()) << 32) | s.size;
+                column.tags[i] = Cell::Type::kString | ColumnStore::kTextTag;
+                column.text.append(s.data, s.size);
+            }
         }
-        int maxx, maxy;
-        std::tie(maxy, maxx) = parse_cellname(dimension_ref.substr(p+1));
-        nrows_ = maxy + 1;
-        ncols_ = maxx + 1;
-        // avoid realloc. (bad access)
-        cells_.resize(nrows_);
-        for (int j = 0; j < nrows_; ++j) {
-            cells_[j].reserve(ncols_);
-        }
-        row_locks = std::unique_ptr<std::vector<std::mutex>>(new std::vector<std::mutex>(nrows_));
-        // for random access xmldoc;
-        row_nodes_.resize(nrows_);
-        for (auto& row : sheet.child("sheetData").children("row")) {
-            int r = row.attribute("r").as_int() - 1;
+        return copies;
+    }
+
+    // decodes all records of a sheet of .xlsb, or of a csv.
+    template<class Reader>
+    Sheet(std::string rid_, std::string name_, Reader& reader,
+          std::shared_ptr<SharedStrings> shared_string_,
+          std::shared_ptr<StyleSheet> style_sheet_)
+            : rid(rid_), name(name_),
+              shared_string(shared_string_),
+              style_sheet(style_sheet_),
+              preloaded(true) {
+        std::tie(nrows_, ncols_) = parse_dimension(reader.dimension);
+        decode(reader, columns);
+        // a csv knows its dimension at the end.
+        std::tie(nrows_, ncols_) = parse_dimension(reader.dimension);
+        finish();
+    }
+
+    inline
+    void finish() {
+        for (auto& column : columns) column.finish();
+        index_rows();
+    }
+
+    inline
+    void index_rows() {
+        std::vector<const ColumnStore*> all;
+        for (auto& column : columns) all.push_back(&column);
+        row_indexes_ = rows_of(all);
+    }
+
+    // rows which have a cell in any of the columns, in order, from their bitmaps.
+    static inline
+    std::vector<int> rows_of(const std::vector<const ColumnStore*>& columns_) {
+        std::vector<uint64_t> any;
+        for (auto column : columns_) {
+            auto words = column->bits_data();
+            if (any.size() < column->nbits()) any.resize(column->nbits(), 0);
+            for (size_t w = 0; w < column->nbits(); ++w) any[w] |= words[w];
+        }
+        std::vector<int> rows;
+        for (size_t w = 0; w < any.size(); ++w) {
+            for (uint64_t bits = any[w]; bits != 0; bits &= bits - 1) {
+                rows.push_back(static_cast<int>(w * 64 + __builtin_ctzll(bits)));
+            }
+        }
+        return rows;
+    }
+
+    template<class Reader>
+    void decode(Reader& reader, std::vector<ColumnStore>& columns_) {
+        RawRow raw;
+        while (reader.next_row(raw)) {
+            int r = raw.index;
             if (r < 0 || nrows_ <= r) {
                 throw Exception("invalid row: ", r);
             }
-            row_nodes_[r] = row;
+            store_row(raw, columns_);
         }
     }
 
+    // decodes chunks of sheetData into their own columns, and appends them in order.
+    // false if the chunks are not in row order, or their rows are implicit.
+    // nothing is stored then.
+    // this thread decodes the first chunk, and idle threads of the process the others.
     inline
-    int nrows() {
+    bool decode_parallel(SheetReader& reader, int nthreads) {
+        ThreadBudget::Lease lease(ThreadBudget::global(), nthreads - 1);
+        if (lease.n == 0) return false;
+        auto chunks = split_rows(reader.data + reader.pos, reader.data + reader.size,
+                                 lease.n + 1);
+        if (chunks.size() <= 2) return false;
+        size_t n = chunks.size() - 1;
+        std::vector<std::vector<ColumnStore>> parts(n);
+        std::vector<uint8_t> implicit(n, 0);
+        auto decode_chunk = [&](size_t k) {
+            SheetReader chunk(chunks[k], chunks[k + 1] - chunks[k], false);
+            chunk.bounds = reader.bounds;
+            decode(chunk, parts[k]);
+            // a row without r follows the previous chunk, which is not known here.
+            if (chunk.implicit_rows) implicit[k] = 1;
+        };
+        std::vector<std::future<void>> tasks;
+        for (size_t k = 1; k < n; ++k) {
+            tasks.push_back(std::async(std::launch::async, decode_chunk, k));
+        }
+        decode_chunk(0);
+        for (auto& task : tasks) task.get();
+        for (size_t k = 1; k < n; ++k) {
+            if (implicit[k]) return false;
+        }
+
+        // rows of each chunk must follow the previous one, as they do in a serial decode.
+        std::vector<int> first_rows(n, -1), last_rows(n, -1);
+        for (size_t k = 0; k < n; ++k) {
+            for (auto& column : parts[k]) {
+                if (column.tags.empty()) continue;
+                int first = column.first_row();
+                if (first_rows[k] == -1 || first < first_rows[k]) first_rows[k] = first;
+                if (last_rows[k] < column.last_row) last_rows[k] = column.last_row;
+            }
+        }
+        int last = -1;
+        for (size_t k = 0; k < n; ++k) {
+            if (first_rows[k] == -1) continue;
+            if (first_rows[k] <= last) return false;
+            last = last_rows[k];
+        }
+        for (size_t k = 0; k < n; ++k) {
+            if (columns.size() < parts[k].size()) columns.resize(parts[k].size());
+            for (size_t i = 0; i < parts[k].size(); ++i) columns[i].append(parts[k][i]);
+        }
+        decoded_chunks = static_cast<int>(n);
+        return true;
+    }
+
+    // boundaries of about n chunks in [begin, end), each starting at <row.
+    // the last element is the end of the rows.
+    static inline
+    std::vector<const char*> split_rows(const char* begin, const char* end, int n) {
+        static const char kRow[] = "<row";
+        static const char kEnd[] = "</sheetData>";
+        std::vector<const char*> chunks;
+        const char* rows_end = search(begin, end, kEnd, sizeof(kEnd) - 1);
+        if (rows_end == end) return chunks;
+        size_t len = rows_end - begin;
+        for (int k = 0; k < n; ++k) {
+            const char* p = begin + len * k / n;
+            while (true) {
+                p = search(p, rows_end, kRow, sizeof(kRow) - 1);
+                if (p == rows_end) break;
+                char c = p[sizeof(kRow) - 1];
+                if (c == ' ' || c == '>' || c == '/' || c == '\t' || c == '\r' || c == '\n') break;
+                ++p;
+            }
+            if (p == rows_end) break;
+            if (!chunks.empty() && chunks.back() >= p) continue;
+            chunks.push_back(p);
+        }
+        chunks.push_back(rows_end);
+        return chunks;
+    }
+
+    static inline
+    const char* search(const char* p, const char* end, const char* term, size_t n) {
+        while (static_cast<size_t>(end - p) >= n) {
+            auto q = static_cast<const char*>(std::memchr(p, term[0], end - p - n + 1));
+            if (q == nullptr) break;
+            if (std::memcmp(q, term, n) == 0) return q;
+            p = q + 1;
+        }
+        return end;
+    }
+
+    inline
+    void store_row(RawRow& raw, std::vector<ColumnStore>& columns_) {
+        int rowx = raw.index;
+        for (size_t k = 0; k < raw.size(); ++k) {
+            auto& c = raw[k];
+            int colx = c.col;
+            // out of dimension. never be read.
+            if (colx < 0 || ncols_ <= colx) continue;
+            if (c.v.empty()) continue;
+            if (columns_.size() <= static_cast<size_t>(colx)) columns_.resize(colx + 1);
+            auto& column = columns_[colx];
+            if (c.t == "s") {
+                auto i = Cell::shared_string_id(c.v, shared_string->size(), rowx, colx);
+                column.set(rowx, kSharedStringTag | Cell::Type::kString, i);
+            } else {
+                auto number = Number::parse(c.v);
+                auto type = Cell::classify(c.v, c.t, c.s, style_sheet, number);
+                if (Cell::has_number(type, number)) {
+                    column.set_number(rowx, kNumberTag | type, c.v,
+                                      Cell::number_bits(type, number));
+                } else {
+                    column.set_text(rowx, type, c.v);
+                }
+            }
+        }
+    }
+
+    // a row of the sheet. cheap to copy, and safe to read from many threads.
+    struct RowView {
+        const Sheet* sheet = nullptr;
+        int index = -1;
+
+        inline int size() const { return sheet->ncols(); }
+        inline Cell cell(int colx) const { return sheet->cell(index, colx); }
+        inline Cell operator[](int colx) const { return cell(colx); }
+    };
+
+    inline
+    int nrows() const {
         return nrows_;
     }
 
     inline
-    int ncols() {
+    int ncols() const {
         return ncols_;
     }
 
+    // rows which have a cell, in order. a sheet formatted as a whole reports a dimension
+    // like A1:XFD1048576, so iterate these rather than up to nrows().
+    inline
+    const std::vector<int>& row_indexes() const {
+        return row_indexes_;
+    }
+
+    // rows which have a cell in any of colxs. a row of the other columns only,
+    // e.g. notes beside the data, or a format down to row 65536, is not listed.
+    // -1 in colxs is ignored.
     inline
-    Cell& cell(const std::string& cellname) {
+    std::vector<int> row_indexes(const std::vector<int>& colxs) const {
+        std::vector<const ColumnStore*> selected;
+        for (int colx : colxs) {
+            if (colx < 0 || columns.size() <= static_cast<size_t>(colx)) continue;
+            selected.push_back(&columns[colx]);
+        }
+        return rows_of(selected);
+    }
+
+    inline
+    RowView row(int rowx) const {
+        RowView view;
+        view.sheet = this;
+        view.index = rowx;
+        return view;
+    }
+
+    inline
+    Cell cell(const std::string& cellname) const {
         int rowx, colx;
         std::tie(rowx, colx) = parse_cellname(cellname);
         return cell(rowx, colx);
     }
 
     inline
-    Cell& cell(int rowx, int colx) {
+    Cell cell(int rowx, int colx) const {
         // row, col: 0-index
-        auto nrowx = nrows();
-        auto ncolx = ncols();
-        if (rowx < 0 || nrowx <= rowx) return ncell;
-        if (colx < 0 || ncolx <= colx) return ncell;
-
-        std::lock_guard<std::mutex> lock((*row_locks)[rowx]);
-        if (colx < cells_[rowx].size()) {
-            return cells_[rowx][colx];
-        }
-        // std::cerr << "ncols=" << ncolx << " nrows=" << nrowx << std::endl;
-
-        auto& row_cells = cells_[rowx];
-        row_cells.clear();
-        row_cells.reserve(ncolx);
-        int i = 0;
-        for (auto& c : row_nodes_[rowx].children("c")) {
-            std::string r = c.attribute("r").as_string();
-            int colx, rowx_;
-            std::tie(rowx_, colx) = parse_cellname(r);
-            if (rowx_ != rowx) {
-                throw Exception("bad. r=", r, " row=", rowx, " parsed_row=", rowx_);
-            }
-            std::string t = c.attribute("t").as_string();
-            auto s = c.attribute("s").as_int();
-            std::string v = c.child("v").text().as_string();
-            auto cell = Cell(rowx, colx, v, t, s, shared_string, style_sheet);
-            if (row_cells.size() <= colx) {
-                for (int j = row_cells.size(); j < colx; ++j) {
+        if (rowx < 0 || nrows_ <= rowx) return Cell();
+        if (colx < 0 || ncols_ <= colx) return Cell();
+        if (columns.size() <= static_cast<size_t>(colx)) return Cell(rowx, colx);
+
+        auto& column = columns[colx];
+        auto idx = column.find(rowx);
+        if (idx < 0) return Cell(rowx, colx);
+        uint8_t tag = column.tag_at(idx);
+        if (tag & kSharedStringTag) {
+            return Cell(rowx, colx, Cell::Type::kString, shared_string->at(column.value_at(idx)));
+        }
+        auto type = static_cast<Cell::Type>(tag & kTypeMask);
+        auto cell = Cell(rowx, colx, type, column.text_at(idx));
+        if (tag & kNumberTag) cell.set_number(column.number_at(idx));
+        return cell;
+    }
+
+    inline
+    size_t memory_usage() const {
+        size_t n = 0;
+        for (auto& column : columns) n += column.memory_usage();
+        return n;
+    }
+
+    // only: the columns to be decoded. the others are left empty.
+    // except: the columns decoded into row_cells before, which are kept as they are.
+    static inline
+    void decode_row(RawRow& raw, std::vector<Cell>& row_cells,
+                    const std::shared_ptr<SharedStrings>& shared_string,
+                    const std::shared_ptr<StyleSheet>& style_sheet,
+                    const ColumnProjection* only = nullptr,
+                    const ColumnProjection* except = nullptr) {
+        int rowx = raw.index;
+        for (size_t k = 0; k < raw.size(); ++k) {
+            auto& c = raw[k];
+            int colx = c.col;
+            if (only != nullptr && !only->contains(colx)) continue;
+            if (except != nullptr && except->contains(colx)) continue;
+            auto cell = Cell(rowx, colx, c.v, c.t, c.s, shared_string, style_sheet);
+            if (row_cells.size() <= static_cast<size_t>(colx)) {
+                for (int j = static_cast<int>(row_cells.size()); j < colx; ++j) {
                     // fill empty cells
                     row_cells.push_back(Cell(rowx, j));
                 }
@@ -476,104 +877,203 @@ struct Sheet {
                 row_cells[colx] = std::move(cell);
             }
         }
-        for (int i = row_cells.size(); i < ncols(); ++i) {
-            // fill empty cells
-            row_cells.push_back(Cell(rowx, i));
-        }
-        return row_cells[colx];
     }
 
-    inline
-    std::tuple<int, int> parse_cellname(std::string r) {
-        size_t p = std::string::npos;
-        int colx = 0;
-        for (size_t i = 0; i < r.size(); ++i) {
-            uint8_t c = r[i];
-            if ('A' <= c && c <= 'Z') {
-                colx = colx * ('Z' - 'A' + 1) + (c - 'A' + 1);
-            } else if ('0' <= c && c <= '9') {
-                p = i;
-                break;
-            } else {
-                throw Exception("bad position char. row");
-            }
-        }
-        colx--;
+    static inline
+    std::tuple<int, int> parse_dimension(const std::string& dimension_ref) {
+        auto p = dimension_ref.find(':');
         if (p == std::string::npos) {
-            throw Exception("bad position char. col");
+            throw Exception("invalid demension: ", dimension_ref);
+        }
+        int maxx, maxy;
+        if (!CellRef::parse(dimension_ref.data() + p + 1,
+                            dimension_ref.data() + dimension_ref.size(), maxy, maxx)) {
+            throw Exception("invalid demension: ", dimension_ref);
+        }
+        return std::make_tuple(maxy + 1, maxx + 1);
+    }
+
+    static inline
+    std::tuple<int, int> parse_cellname(const std::string& r) {
+        int rowx, colx;
+        if (!CellRef::parse(r.data(), r.data() + r.size(), rowx, colx)) {
+            throw Exception("bad cell reference: ", r);
         }
-        int rowx = std::stoi(r.substr(p)) - 1;
         return std::make_tuple(rowx, colx);
     }
 };
 
-
 struct Workbook {
+    struct Options {
+        // read the container with ZipReader (mmap) instead of ZipLib.
+        bool mmap = true;
+        // decode sharedStrings.xml and styles.xml on other threads. (mmap only)
+        bool parallel = true;
+        // read sharedStrings.xml and styles.xml on first use instead. (mmap only)
+        // a sheet of numbers, or a probe of its header, may never need them.
+        bool lazy = false;
+        // inflate this sheet while the other parts are decoded.
+        std::string prefetch_sheet;
+        // threads to decode a large sheet with (buffered mode), or to index sharedStrings.xml.
+        int decode_threads = 1;
+        // decoded sheets are stored here, and mapped again while the file is unchanged.
+        // empty: disabled. (buffered mode)
+        std::string snapshot_dir;
+        // entries whose crc matched are recorded in snapshot_dir, and not checked again
+        // while the file is unchanged.
+        bool skip_verified = false;
+        // not 0: the file is a csv of this delimiter, read as a sheet named "".
+        char delimiter = 0;
+    };
+
+    Options options;
+    std::string path;
+    // .xlsb, whose parts are BIFF12 records instead of xml.
+    bool binary = false;
+    int64_t file_size = 0;
+    int64_t file_mtime = 0;
     ZipArchive::Ptr archive;
+    std::unique_ptr<ZipReader> zip;
+    // the whole file of a csv. (options.delimiter)
+    std::unique_ptr<MappedFile> csv;
+    // name -> index of the ZipLib archive. ZipReader has its own hashed index.
     std::unordered_map<std::string, int> entry_indexes;
-    std::vector<std::string> entry_names;  // for debug
     std::unordered_map<std::string, std::string> rels;
     int nsheets_ = -1;
 
     std::unordered_map<std::string, std::string> sheet_rid_by_name;
     std::unordered_map<std::string, std::string> sheet_name_by_rid;
-    std::unordered_map<std::string, Sheet> sheets;
-    std::shared_ptr<std::vector<std::string>> shared_string;
+    // a slot for each sheet in workbook.xml. the map itself is not modified after construction.
+    // a sheet is decoded once, then published as immutable and read without locks.
+    struct SheetSlot {
+        std::once_flag once;
+        std::unique_ptr<Sheet> sheet;
+    };
+    std::unordered_map<std::string, std::unique_ptr<SheetSlot>> sheets;
+    // sheets read within a range, by "rid!B5:K2000". added on first use, under sheet_mutex.
+    std::unordered_map<std::string, std::unique_ptr<SheetSlot>> ranged_sheets;
+    std::mutex sheet_mutex;
+    std::shared_ptr<SharedStrings> shared_string;
     std::shared_ptr<StyleSheet> style_sheet;
+    std::unordered_map<std::string, std::string> prefetched_entries;
 
-    std::mutex sheet_mutex;
+    // guards prefetched_entries, and the ZipLib archive whose entries share one stream.
+    std::mutex entry_mutex;
+
+    // "name:crc" of the entries verified by this or an earlier run. (skip_verified)
+    // written to verified_file once, when the workbook is destroyed.
+    std::unordered_set<std::string> verified;
+    std::string verified_file;
+    std::mutex verified_mutex;
+    bool verified_changed = false;
 
     Workbook() = delete;
 
     inline
-    explicit Workbook(std::string filename)
-            : shared_string(new std::vector<std::string>()) {
+    explicit Workbook(std::string filename) : Workbook(filename, Options()) {}
+
+    inline
+    Workbook(std::string filename, Options options_)
+            : options(options_),
+              shared_string(new SharedStrings()) {
         struct stat statbuf;
         if (::stat(filename.c_str(), &statbuf) != 0) {
             throw Exception("file=", filename, " does not exist.");
         }
+        path = filename;
+        file_size = statbuf.st_size;
+        file_mtime = statbuf.st_mtime;
+        if (options.delimiter != 0) {
+            // one sheet, related to the file itself.
+            csv.reset(new MappedFile(filename));
+            add_sheet("rId1", "");
+            rels["rId1"] = filename;
+            return;
+        }
+        binary = is_xlsb(filename);
+        if (options.skip_verified && !options.snapshot_dir.empty()) {
+            verified_file = Snapshot::filename(options.snapshot_dir, path, "", ".verified");
+            load_verified();
+        }
 
-        archive = ZipFile::Open(filename);
+        if (options.mmap) {
+            zip = std::unique_ptr<ZipReader>(new ZipReader(filename));
+        } else {
+            archive = ZipFile::Open(filename);
+        }
 
         int max_sheet_id = -1;
-        size_t count = archive->GetEntriesCount();
+        if (!zip) {
+            // ZipLib has built the names of all entries anyway.
+            for (size_t i = 0; i < entries_count(); ++i) {
+                std::string fullname = entry_name(i);
+                auto p = fullname.rfind('.');
+                if (p == std::string::npos) continue;
+                auto ext = fullname.substr(p);
+                if (ext != ".xml" && ext != ".rels" && ext != ".bin") continue;
+                entry_indexes[fullname] = i;
+            }
+        }
+        // the sheets are related by workbook.xml. the other rels are not read unless it is missing.
         std::vector<int> rel_entries;
-        for (size_t i = 0; i < count; ++i) {
-            auto entry = archive->GetEntry(static_cast<int>(i));
-            std::string fullname = entry->GetFullName();
-            auto p = fullname.rfind('.');
-            if (p == std::string::npos) continue;
-            auto ext = fullname.substr(p);
-            if (ext == ".xml") {
-            } else if (ext == ".rels") {
-                rel_entries.push_back(i);
-            } else {
-                continue;
+        int workbook_rels = find_entry(part("xl/_rels/workbook", ".rels"));
+        if (workbook_rels != -1) {
+            rel_entries.push_back(workbook_rels);
+        } else {
+            for (size_t i = 0; i < entries_count(); ++i) {
+                auto name = entry_name(i);
+                if (name.size() >= 5 && name.compare(name.size() - 5, 5, ".rels") == 0) {
+                    rel_entries.push_back(i);
+                }
             }
-            entry_indexes[fullname] = i;
-            entry_names.push_back(fullname);
         }
 
-        if (entry_indexes.count("xl/workbook.xml") == 0) {
-            throw Exception("cant find xl/workbook.xml !!");
+        if (find_entry(part("xl/workbook")) == -1) {
+            throw Exception("cant find ", part("xl/workbook"), " !!");
         }
-        if (entry_indexes.count("xl/sharedStrings.xml") == 0) {
+        // a binary workbook has no sharedStrings.bin if it has no strings.
+        if (!binary && find_entry("xl/sharedStrings.xml") == -1) {
             throw Exception("cant find xl/sharedStrings.xml !!");
         }
-        if (entry_indexes.count("xl/styles.xml") == 0) {
-            throw Exception("cant find xl/styles.xml !!");
+        if (find_entry(part("xl/styles")) == -1) {
+            throw Exception("cant find ", part("xl/styles"), " !!");
         }
         if (rel_entries.empty()) {
             throw Exception("cant find rels !!");
         }
 
+        // the parts are independent. ZipLib shares one ifstream between entries,
+        // so they are decoded concurrently only on the mmap backend.
+        // lazy ones are read by the first cell which needs them, maybe never.
+        // ZipLib may be in the middle of a sheet stream then, so it always reads them here.
+        bool lazy = zip && options.lazy;
+        auto policy = zip && options.parallel ? std::launch::async : std::launch::deferred;
+        std::future<void> shared_string_task, style_sheet_task;
+        auto load_shared_string = [this](SharedStrings& sst) { load_part(sst); };
+        auto load_style_sheet = [this](StyleSheet& style) { load_part(style); };
+        if (lazy) {
+            shared_string = std::make_shared<SharedStrings>(load_shared_string);
+            style_sheet = std::make_shared<StyleSheet>(load_style_sheet);
+        } else {
+            shared_string_task = std::async(policy, [=]() {
+                auto sst = std::make_shared<SharedStrings>(load_shared_string);
+                sst->deferred.ensure();
+                shared_string = sst;
+            });
+            style_sheet_task = std::async(policy, [=]() {
+                auto style = std::make_shared<StyleSheet>(load_style_sheet);
+                style->deferred.ensure();
+                style_sheet = style;
+            });
+        }
+
         for (int i : rel_entries) {
             auto doc = load_doc(i);
             for (auto rel : doc->child("Relationships").children("Relationship")) {
                 auto rid = rel.attribute("Id").as_string();
                 std::string target = rel.attribute("Target").as_string();
                 auto ext = target.substr(target.size()-4);
-                if (ext != ".xml") continue;
+                if (ext != (binary ? ".bin" : ".xml")) continue;
                 std::string type = rel.attribute("Type").as_string();
                 if (!type.empty() && !is_reltype_worksheet(type)) continue;
                 auto head = target.substr(0, 3);
@@ -583,38 +1083,104 @@ struct Workbook {
                     target = "xl/" + target;
                 }
                 if (rels.count(rid) != 0) {
-                    throw Exception("duplicate r:id=", rid, " entry=", entry_names[i]);
+                    throw Exception("duplicate r:id=", rid, " entry=", entry_name(i));
                 }
                 rels[rid] = target;
             }
         }
 
-        auto workbook_doc = load_doc("xl/workbook.xml");
-        for (auto sheet : workbook_doc->child("workbook").child("sheets").children("sheet")) {
-            // auto sheet_id = sheet.attribute("sheetId").as_int();
-            auto sheet_rid = sheet.attribute("r:id").as_string();
-            auto sheet_name = sheet.attribute("name").as_string();
-            sheet_rid_by_name[sheet_name] = sheet_rid;
-            sheet_name_by_rid[sheet_rid] = sheet_name;
-        }
-
-        auto shared_string_doc = load_doc("xl/sharedStrings.xml");
-        for (auto si : shared_string_doc->child("sst").children("si")) {
-            std::string text;
-            for (auto child : si.children()) {
-                std::string name = child.name();
-                if (name == "t") {
-                    text.append(child.text().as_string());
-                } else if (name == "r") {
-                    for (auto node : child.children("t")) {
-                        text.append(node.text().as_string());
-                    }
+        if (binary) {
+            auto data = read_entry("xl/workbook.bin");
+            for (auto& sheet : XlsbWorkbook(data.data(), data.size()).sheets) {
+                add_sheet(sheet.first, sheet.second);
+            }
+        } else {
+            auto workbook_doc = load_doc("xl/workbook.xml");
+            for (auto sheet : workbook_doc->child("workbook").child("sheets").children("sheet")) {
+                // auto sheet_id = sheet.attribute("sheetId").as_int();
+                add_sheet(sheet.attribute("r:id").as_string(), sheet.attribute("name").as_string());
+            }
+        }
+
+        if (!options.prefetch_sheet.empty() && sheet_rid_by_name.count(options.prefetch_sheet)) {
+            auto entry_name = rels[sheet_rid_by_name[options.prefetch_sheet]];
+            int index = find_entry(entry_name);
+            if (index != -1) {
+                auto reader = open_entry(index);
+                if (reader->stored_data() == nullptr) {
+                    std::string buffer(reader->size(), '\0');
+                    reader->read_all(&buffer[0]);
+                    prefetched_entries[entry_name] = std::move(buffer);
                 }
             }
-            shared_string->push_back(text);
         }
 
-        style_sheet = std::make_shared<StyleSheet>(load_doc("xl/styles.xml"));
+        if (!lazy) {
+            shared_string_task.get();
+            style_sheet_task.get();
+        }
+    }
+
+    inline
+    void add_sheet(const std::string& rid, const std::string& name) {
+        sheet_rid_by_name[name] = rid;
+        sheet_name_by_rid[rid] = name;
+        sheets[rid].reset(new SheetSlot());
+    }
+
+    static inline
+    bool is_xlsb(const std::string& filename) {
+        auto p = filename.rfind('.');
+        if (p == std::string::npos) return false;
+        auto ext = filename.substr(p);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        return ext == ".xlsb";
+    }
+
+    // name of a part, in xml or binary.
+    inline
+    std::string part(const std::string& stem, const char* suffix = "") {
+        return stem + (binary ? ".bin" : ".xml") + suffix;
+    }
+
+    // xl/sharedStrings.xml, or sharedStrings.bin of a binary workbook.
+    inline
+    void load_part(SharedStrings& sst) {
+        if (!binary) {
+            sst.load_xml(read_entry("xl/sharedStrings.xml"), options.decode_threads);
+            return;
+        }
+        if (find_entry("xl/sharedStrings.bin") == -1) {
+            sst.assign(std::vector<std::string>());
+            return;
+        }
+        auto data = read_entry("xl/sharedStrings.bin");
+        sst.assign(XlsbSharedStrings(data.data(), data.size()).strings);
+    }
+
+    // xl/styles.xml, or styles.bin of a binary workbook.
+    inline
+    void load_part(StyleSheet& style) {
+        if (!binary) {
+            style.load(load_doc("xl/styles.xml"));
+            return;
+        }
+        auto data = read_entry("xl/styles.bin");
+        XlsbStyles styles(data.data(), data.size());
+        style.assign(std::move(styles.format_codes), std::move(styles.num_fmts_by_xf_index));
+    }
+
+    // whole content of an entry.
+    inline
+    std::string read_entry(const std::string& name) {
+        auto reader = open_entry(entry_index(name));
+        std::string data(reader->size(), '\0');
+        if (reader->stored_data() != nullptr) {
+            std::memcpy(&data[0], reader->stored_data(), data.size());
+        } else {
+            reader->read_all(&data[0]);
+        }
+        return data;
     }
 
     static inline
@@ -627,26 +1193,115 @@ struct Workbook {
     }
 
     inline
-    std::string read_entry(int index) {
-        if (index < 0 || entry_names.size() <= index) {
+    size_t entries_count() {
+        if (zip) return zip->size();
+        return archive->GetEntriesCount();
+    }
+
+    inline
+    std::string entry_name(int index) {
+        if (zip) return zip->entries[index].name.str();
+        return archive->GetEntry(index)->GetFullName();
+    }
+
+    inline
+    std::unique_ptr<EntryReader> open_entry(int index) {
+        if (index < 0 || entries_count() <= static_cast<size_t>(index)) {
             throw Exception("entry_index=", index, ": out of range.");
         }
-        auto entry = archive->GetEntry(index);
-        auto stream_ptr = entry->GetDecompressionStream();
-        if (stream_ptr == nullptr) {
-            throw Exception("entry=", entry_names[index], ": cant decode stream.");
+        std::unique_ptr<EntryReader> reader;
+        if (zip) {
+            reader.reset(new EntryReader(*zip, index));
+        } else {
+            reader.reset(new EntryReader(archive->GetEntry(index)));
+        }
+        if (!verified_file.empty() && reader->verify) {
+            auto id = reader->name + ':' + std::to_string(reader->expected_crc);
+            std::lock_guard<std::mutex> lock(verified_mutex);
+            if (verified.count(id) != 0) {
+                reader->verify = false;
+            } else {
+                reader->on_verified = [this, id]() { record_verified(id); };
+            }
+        }
+        return reader;
+    }
+
+    // the record is of this file as it is now, or it is ignored.
+    inline
+    std::string verified_key() {
+        std::ostringstream key;
+        key << path << '\t' << file_size << '\t' << file_mtime;
+        return key.str();
+    }
+
+    inline
+    ~Workbook() {
+        save_verified();
+    }
+
+    inline
+    void load_verified() {
+        std::ifstream in(verified_file.c_str());
+        std::string line;
+        if (!std::getline(in, line) || line != verified_key()) return;
+        while (std::getline(in, line)) verified.insert(line);
+    }
+
+    inline
+    void record_verified(const std::string& id) {
+        std::lock_guard<std::mutex> lock(verified_mutex);
+        if (verified.insert(id).second) verified_changed = true;
+    }
+
+    // rewritten as a whole, and renamed. a record is only a cache, so a failure is ignored.
+    inline
+    void save_verified() {
+        std::lock_guard<std::mutex> lock(verified_mutex);
+        if (!verified_changed) return;
+        verified_changed = false;
+        auto tmp = verified_file + ".tmp";
+        {
+            std::ofstream out(tmp.c_str(), std::ios::trunc);
+            out << verified_key() << '\n';
+            for (auto& v : verified) out << v << '\n';
+            out.flush();
+            if (!out) {
+                out.close();
+                std::remove(tmp.c_str());
+                return;
+            }
         }
-        std::stringstream ss;
-        ss << stream_ptr->rdbuf();
-        return ss.str();
+        if (std::rename(tmp.c_str(), verified_file.c_str()) != 0) std::remove(tmp.c_str());
     }
 
     inline
     std::unique_ptr<pugi::xml_document> load_doc(int index) {
-        auto xmlsource = read_entry(index);
-        // std::cerr << xmlsource << std::endl;
+        // inflate into one buffer sized from the central directory,
+        // and let pugixml parse it in place.
+        auto reader_ptr = open_entry(index);
+        auto& reader = *reader_ptr;
+        auto size = reader.size();
         auto doc = std::unique_ptr<pugi::xml_document>(new pugi::xml_document());
-        auto result = doc->load_string(xmlsource.c_str());
+        if (reader.stored_data() != nullptr) {
+            // mapped memory is read-only. pugixml copies it.
+            if (!doc->load_buffer(reader.stored_data(), size)) {
+                throw Exception("parse error!!");
+            }
+            return doc;
+        }
+        auto buffer = static_cast<char*>(pugi::get_memory_allocation_function()(size + 1));
+        if (buffer == nullptr) {
+            throw Exception("entry=", reader.name, ": out of memory. size=", size);
+        }
+        try {
+            reader.read_all(buffer);
+        } catch (...) {
+            pugi::get_memory_deallocation_function()(buffer);
+            throw;
+        }
+        // the document owns the buffer.
+        auto result = doc->load_buffer_inplace_own(buffer, size);
         if (!result) {
             throw Exception("parse error!!");
         }
@@ -655,38 +1310,298 @@ struct Workbook {
 
     inline
     std::unique_ptr<pugi::xml_document> load_doc(const std::string& name) {
-        auto it = entry_indexes.find(name);
-        if (it == entry_indexes.end()) {
+        return load_doc(entry_index(name));
+    }
+
+    inline int nsheets() { return nsheets_; }
+
+    inline
+    int entry_index(const std::string& name) {
+        int index = find_entry(name);
+        if (index == -1) {
             throw Exception("entry=", name, ": not found.");
         }
-        return load_doc(it->second);
+        return index;
     }
 
-    inline int nsheets() { return nsheets_; }
+    // index of an entry, or -1.
+    inline
+    int find_entry(const std::string& name) {
+        if (zip) return zip->find(name);
+        auto it = entry_indexes.find(name);
+        return it == entry_indexes.end() ? -1 : it->second;
+    }
 
+    // cells out of range are not decoded. such a sheet is another one of the whole sheet.
     inline
-    Sheet& sheet(std::string rid) {
-        std::lock_guard<std::mutex> lock(sheet_mutex);
+    Sheet& sheet(const std::string& rid, const CellRange& range = CellRange()) {
         auto it = sheets.find(rid);
-        if (it != sheets.end()) {
-            return it->second;
+        auto rel = rels.find(rid);
+        if (it == sheets.end() || rel == rels.end()) {
+            throw Exception("sheet rid=", rid, ": not found.");
+        }
+        auto& slot = range.whole() ? *it->second : ranged_slot(rid, range);
+        std::call_once(slot.once, [&]() {
+            auto& name = sheet_name_by_rid.at(rid);
+            auto bounds = range.whole() ? nullptr : &range;
+            std::string snapshot, key;
+            if (!options.snapshot_dir.empty()) {
+                auto ref = range.whole() ? name : name + '!' + range.ref();
+                snapshot = Snapshot::filename(options.snapshot_dir, path, ref);
+                key = snapshot_key(rid, range);
+                int nrows, ncols;
+                std::vector<ColumnStore> columns;
+                if (Snapshot::read(snapshot, key, nrows, ncols, columns)) {
+                    slot.sheet.reset(new Sheet(rid, name, nrows, ncols, std::move(columns),
+                                               shared_string, style_sheet));
+                    return;
+                }
+            }
+            if (csv) {
+                CsvReader reader(csv->data, csv->size, options.delimiter);
+                reader.bounds = bounds;
+                slot.sheet.reset(new Sheet(rid, name, reader, shared_string, style_sheet));
+            } else if (binary) {
+                read_binary_sheet(rel->second, [&](XlsbSheetReader& reader) {
+                    reader.bounds = bounds;
+                    slot.sheet.reset(new Sheet(rid, name, reader, shared_string, style_sheet));
+                });
+            } else {
+                // the parallel decoder needs the whole sheet in memory.
+                bool whole = options.decode_threads > 1;
+                read_sheet(rel->second, [&](SheetReader& reader) {
+                    reader.bounds = bounds;
+                    slot.sheet.reset(new Sheet(rid, name, reader, shared_string, style_sheet,
+                                               options.decode_threads));
+                }, whole);
+            }
+            if (!snapshot.empty()) {
+                // it is only a cache. the sheet is used anyway.
+                try {
+                    auto& sheet = *slot.sheet;
+                    Snapshot::write(snapshot, key, sheet.nrows(), sheet.ncols(),
+                                    sheet.detached_columns());
+                } catch (std::exception&) {}
+            }
+        });
+        return *slot.sheet;
+    }
+
+    inline
+    SheetSlot& ranged_slot(const std::string& rid, const CellRange& range) {
+        std::lock_guard<std::mutex> lock(sheet_mutex);
+        auto& slot = ranged_sheets[rid + '!' + range.ref()];
+        if (!slot) slot.reset(new SheetSlot());
+        return *slot;
+    }
+
+    // anything a decoded sheet depends on. a snapshot of another key is not used.
+    inline
+    std::string snapshot_key(const std::string& rid, const CellRange& range = CellRange()) {
+        std::ostringstream key;
+        key << path << '\n' << file_size << '\n' << file_mtime << '\n'
+            << sheet_name_by_rid.at(rid);
+        if (!range.whole()) key << '!' << range.ref();
+        for (auto& name : {rels.at(rid), part("xl/sharedStrings"), part("xl/styles")}) {
+            key << '\n' << name << ':' << entry_crc(name);
         }
-        auto entry_name = rels[rid];
-        auto sheet_name = sheet_name_by_rid[rid];
-        auto doc = load_doc(entry_name);
-        // auto sheet = Sheet(rid, sheet_name, std::move(doc), shared_string, style_sheet);
-        auto em = sheets.emplace(std::piecewise_construct, std::make_tuple(rid),
-                                 std::make_tuple(rid, sheet_name, std::move(doc),
-                                                 shared_string, style_sheet));
-        return em.first->second;
+        return key.str();
+    }
+
+    // crc32 in the central directory. 0 if there is no such entry.
+    inline
+    uint32_t entry_crc(const std::string& name) {
+        int index = find_entry(name);
+        if (index == -1) return 0;
+        if (zip) return zip->entries[index].crc32;
+        return archive->GetEntry(index)->GetCrc32();
     }
 
     inline
-    Sheet& sheet_by_name(std::string name) {
-        if (sheet_rid_by_name.count(name) == 0) {
+    Sheet& sheet_by_name(const std::string& name, const CellRange& range = CellRange()) {
+        auto it = sheet_rid_by_name.find(name);
+        if (it == sheet_rid_by_name.end()) {
             throw Exception("sheet_name=", name, ": not found.");
         }
-        return sheet(sheet_rid_by_name[name]);
+        return sheet(it->second, range);
+    }
+
+    // a reference like B5:K2000, or the name of a table of the sheet. empty: the whole sheet.
+    inline
+    CellRange range_by_name(const std::string& sheet_name, const std::string& ref) {
+        CellRange range;
+        if (ref.empty() || CellRange::parse(ref, range)) return range;
+        return table_range(sheet_name, ref);
+    }
+
+    // ref of a table, by its name. tables are parts related by the sheet,
+    // e.g. xl/tables/table1.xml by xl/worksheets/_rels/sheet1.xml.rels.
+    inline
+    CellRange table_range(const std::string& sheet_name, const std::string& table_name) {
+        auto it = sheet_rid_by_name.find(sheet_name);
+        if (it == sheet_rid_by_name.end()) {
+            throw Exception("sheet_name=", sheet_name, ": not found.");
+        }
+        if (binary) {
+            throw Exception("table=", table_name, ": tables of .xlsb are not supported.");
+        }
+        auto& entry = rels.at(it->second);
+        auto slash = entry.rfind('/');
+        auto dir = entry.substr(0, slash + 1);
+        auto sheet_rels = dir + "_rels/" + entry.substr(slash + 1) + ".rels";
+        if (find_entry(sheet_rels) != -1) {
+            auto doc = load_doc(sheet_rels);
+            for (auto rel : doc->child("Relationships").children("Relationship")) {
+                std::string type = rel.attribute("Type").as_string();
+                if (type.size() < 6 || type.compare(type.size() - 6, 6, "/table") != 0) continue;
+                auto target = resolve_part(dir, rel.attribute("Target").as_string());
+                if (find_entry(target) == -1) continue;
+                auto table = load_doc(target)->child("table");
+                if (table_name != table.attribute("name").as_string() &&
+                    table_name != table.attribute("displayName").as_string()) {
+                    continue;
+                }
+                std::string ref = table.attribute("ref").as_string();
+                CellRange range;
+                if (!CellRange::parse(ref, range)) {
+                    throw Exception("table=", table_name, ": bad ref=", ref);
+                }
+                return range;
+            }
+        }
+        throw Exception("sheet_name=", sheet_name, ": table=", table_name, ": not found.");
+    }
+
+    // name of a part by a Target of rels in dir. ("xl/worksheets/", "../tables/table1.xml")
+    static inline
+    std::string resolve_part(const std::string& dir, const std::string& target) {
+        if (!target.empty() && target[0] == '/') return target.substr(1);
+        auto base = dir;
+        size_t p = 0;
+        while (target.compare(p, 3, "../") == 0) {
+            auto slash = base.rfind('/', base.size() < 2 ? 0 : base.size() - 2);
+            base = slash == std::string::npos ? std::string() : base.substr(0, slash + 1);
+            p += 3;
+        }
+        return base + target.substr(p);
+    }
+
+    // streaming mode: calls f(Row&) for each <row> without keeping the sheet.
+    // cells out of projection are not decoded. f may narrow it while reading.
+    // rows and cells out of bounds are not decoded, and rows past them are not read.
+    // a row the filter rejects is not decoded further, nor given to f.
+    template<class F>
+    void each_row(const std::string& name, F f, const ColumnProjection* projection = nullptr,
+                  const CellRange* bounds = nullptr, const RowFilter* filter = nullptr) {
+        auto it = sheet_rid_by_name.find(name);
+        if (it == sheet_rid_by_name.end()) {
+            throw Exception("sheet_name=", name, ": not found.");
+        }
+        auto& entry_name = rels.at(it->second);
+        if (csv) {
+            CsvReader reader(csv->data, csv->size, options.delimiter);
+            each_row_of(reader, f, projection, bounds, filter);
+            return;
+        }
+        if (binary) {
+            read_binary_sheet(entry_name, [&](XlsbSheetReader& reader) {
+                each_row_of(reader, f, projection, bounds, filter);
+            });
+            return;
+        }
+        read_sheet(entry_name, [&](SheetReader& reader) {
+            each_row_of(reader, f, projection, bounds, filter);
+        });
+    }
+
+    template<class Reader, class F>
+    void each_row_of(Reader& reader, F& f, const ColumnProjection* projection,
+                     const CellRange* bounds, const RowFilter* filter) {
+        reader.projection = projection;
+        reader.bounds = bounds;
+        int nrows;
+        std::tie(nrows, std::ignore) = Sheet::parse_dimension(reader.dimension);
+        RawRow raw;
+        Row row;
+        while (reader.next_row(raw)) {
+            if (raw.index < 0 || nrows <= raw.index) {
+                throw Exception("invalid row: ", raw.index);
+            }
+            row.index = raw.index;
+            row.cells.clear();
+            if (filter != nullptr && filter->accept && filter->first_row <= raw.index) {
+                Sheet::decode_row(raw, row.cells, shared_string, style_sheet, &filter->columns);
+                if (!filter->accept(row)) continue;
+                // the cells of the filter are decoded once. only the others are left.
+                Sheet::decode_row(raw, row.cells, shared_string, style_sheet, nullptr,
+                                  &filter->columns);
+            } else {
+                Sheet::decode_row(raw, row.cells, shared_string, style_sheet);
+            }
+            f(row);
+        }
+    }
+
+    // records of a binary sheet are compact, so it is read at once.
+    template<class F>
+    void read_binary_sheet(const std::string& entry_name, F f) {
+        std::unique_lock<std::mutex> lock(entry_mutex);
+        std::string buffer;
+        auto it = prefetched_entries.find(entry_name);
+        if (it != prefetched_entries.end()) {
+            buffer = std::move(it->second);
+            prefetched_entries.erase(it);
+        } else {
+            if (zip) lock.unlock();
+            auto entry_reader = open_entry(entry_index(entry_name));
+            if (entry_reader->stored_data() != nullptr) {
+                if (lock.owns_lock()) lock.unlock();
+                XlsbSheetReader reader(entry_reader->stored_data(), entry_reader->size());
+                f(reader);
+                return;
+            }
+            buffer.resize(entry_reader->size());
+            entry_reader->read_all(&buffer[0]);
+        }
+        if (lock.owns_lock()) lock.unlock();
+        XlsbSheetReader reader(buffer.data(), buffer.size());
+        f(reader);
+    }
+
+    // whole: inflates a large entry at once, instead of streaming it.
+    template<class F>
+    void read_sheet(const std::string& entry_name, F f, bool whole = false) {
+        std::unique_lock<std::mutex> lock(entry_mutex);
+        auto it = prefetched_entries.find(entry_name);
+        if (it != prefetched_entries.end()) {
+            auto buffer = std::move(it->second);
+            prefetched_entries.erase(it);
+            lock.unlock();
+            SheetReader reader(buffer.data(), buffer.size());
+            f(reader);
+            return;
+        }
+        // entries of the mapped zip are read independently.
+        if (zip) lock.unlock();
+        auto entry_reader = open_entry(entry_index(entry_name));
+        if (entry_reader->stored_data() != nullptr) {
+            // zero-copy
+            SheetReader reader(entry_reader->stored_data(), entry_reader->size());
+            f(reader);
+            return;
+        }
+        if (whole && entry_reader->size() >= Sheet::kParallelDecodeSize) {
+            std::string buffer(entry_reader->size(), '\0');
+            entry_reader->read_all(&buffer[0]);
+            entry_reader.reset();
+            if (lock.owns_lock()) lock.unlock();
+            SheetReader reader(buffer.data(), buffer.size());
+            f(reader);
+            return;
+        }
+        SheetReader reader([&](char* dst, size_t n) { return entry_reader->read(dst, n); });
+        f(reader);
+        entry_reader->finish();
     }
 };
 
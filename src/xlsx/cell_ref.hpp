@@ -0,0 +1,131 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace xlsx {
+
+// A1 style cell reference, decoded from the raw bytes without allocation or exceptions.
+struct CellRef {
+    // class of each byte: 1..26 for 'A'..'Z', kDigit|n for '0'..'9', kOther for the rest.
+    static const uint8_t kOther = 0xFF;
+    static const uint8_t kDigit = 0x40;
+    // XFD is the last column, and 1048576 the last row. a bit more is accepted.
+    static const int kMaxLetters = 4;
+    static const int kMaxDigits = 9;
+
+    struct Table {
+        uint8_t classes[256];
+
+        inline
+        Table() {
+            for (int c = 0; c < 256; ++c) classes[c] = kOther;
+            for (int c = 'A'; c <= 'Z'; ++c) classes[c] = static_cast<uint8_t>(c - 'A' + 1);
+            for (int c = '0'; c <= '9'; ++c) classes[c] = static_cast<uint8_t>(kDigit | (c - '0'));
+        }
+    };
+
+    static inline
+    const uint8_t* classes() {
+        static const Table table;
+        return table.classes;
+    }
+
+    // "AB12" to 0-index rowx and colx. false unless it is 1-4 letters and then 1-9 digits.
+    static inline
+    bool parse(const char* p, const char* end, int& rowx, int& colx) {
+        auto table = classes();
+        int col = 0;
+        const char* q = p;
+        for (; q < end && q - p < kMaxLetters; ++q) {
+            uint8_t c = table[static_cast<uint8_t>(*q)];
+            if (c > 26) break;
+            col = col * 26 + c;
+        }
+        if (q == p) return false;
+        int row = 0;
+        if (!parse_row(q, end, row)) return false;
+        rowx = row - 1;
+        colx = col - 1;
+        return true;
+    }
+
+    // "AB12" of 0-index rowx and colx.
+    static inline
+    std::string name(int rowx, int colx) {
+        char letters[8];
+        int n = 0;
+        for (int k = colx + 1; k > 0 && n < 8; k = (k - 1) / 26) {
+            letters[n++] = static_cast<char>('A' + (k - 1) % 26);
+        }
+        std::string s(letters, n);
+        return std::string(s.rbegin(), s.rend()) + std::to_string(rowx + 1);
+    }
+
+    // 1-index row number of <row r="12">. false unless it is 1-9 digits.
+    static inline
+    bool parse_row(const char* p, const char* end, int& row) {
+        auto table = classes();
+        if (p == end || end - p > kMaxDigits) return false;
+        int n = 0;
+        for (; p < end; ++p) {
+            uint8_t c = table[static_cast<uint8_t>(*p)];
+            if ((c & 0xF0) != kDigit) return false;
+            n = n * 10 + (c & 0x0F);
+        }
+        row = n;
+        return n > 0;
+    }
+};
+
+// rows and columns of a reference like B5:K2000, 0-index and inclusive.
+// the default one is the whole sheet.
+struct CellRange {
+    static const int kMax = 0x7FFFFFFF;
+
+    int first_row = 0;
+    int first_col = 0;
+    int last_row = kMax;
+    int last_col = kMax;
+
+    inline
+    bool whole() const {
+        return first_row == 0 && first_col == 0 && last_row == kMax && last_col == kMax;
+    }
+
+    inline bool contains_row(int rowx) const { return first_row <= rowx && rowx <= last_row; }
+    inline bool contains_col(int colx) const { return first_col <= colx && colx <= last_col; }
+
+    // "B5:K2000", or "B5" of a cell. false unless both ends are cell references in order.
+    static inline
+    bool parse(const char* p, const char* end, CellRange& range) {
+        auto colon = static_cast<const char*>(std::memchr(p, ':', end - p));
+        auto first_end = colon == nullptr ? end : colon;
+        CellRange r;
+        if (!CellRef::parse(p, first_end, r.first_row, r.first_col)) return false;
+        r.last_row = r.first_row;
+        r.last_col = r.first_col;
+        if (colon != nullptr && !CellRef::parse(colon + 1, end, r.last_row, r.last_col)) {
+            return false;
+        }
+        if (r.last_row < r.first_row || r.last_col < r.first_col) return false;
+        range = r;
+        return true;
+    }
+
+    static inline
+    bool parse(const std::string& ref, CellRange& range) {
+        return parse(ref.data(), ref.data() + ref.size(), range);
+    }
+
+    // "B5:K2000". empty for the whole sheet.
+    inline
+    std::string ref() const {
+        if (whole()) return std::string();
+        return CellRef::name(first_row, first_col) + ":" + CellRef::name(last_row, last_col);
+    }
+};
+
+}  // namespace xlsx
@@ -0,0 +1,191 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xlsx/exception.hpp"
+#include "xlsx/string_ref.hpp"
+
+namespace xlsx {
+
+// cells of one column, stored densely.
+// a bitmap tells which rows have a cell, so an empty cell costs a bit.
+// the bitmap grows up to the last cell, so rows past it cost nothing.
+// each present cell has a tag byte and a 64bit value. text is kept in a per-column arena,
+// and its value is (offset << 32 | size).
+// a numeric cell also has its binary value, in the 8 bytes just before the text.
+// a column of a mapped snapshot reads its cells from the mapping instead of the vectors.
+struct ColumnStore {
+    // tag bit of a cell whose value refers to text.
+    static const uint8_t kTextTag = 0x20;
+    // tag bit of a text cell with a binary value in front of it. the other bits are up to the user.
+    static const uint8_t kNumberTag = 0x40;
+
+    // arrays of a mapped column, in the layout of the vectors.
+    struct Mapped {
+        const uint64_t* bits = nullptr;
+        size_t nbits = 0;
+        const uint8_t* tags = nullptr;
+        const uint64_t* values = nullptr;
+        size_t ncells = 0;
+        const char* text = nullptr;
+        size_t ntext = 0;
+    };
+
+    // cells of a column being built. set() and append() write only these.
+    std::vector<uint64_t> bits;
+    std::vector<uint32_t> ranks;  // number of cells before each word of bits.
+    std::vector<uint8_t> tags;
+    std::vector<uint64_t> values;
+    std::string text;
+    int last_row = -1;
+    // shared by the columns of a snapshot, and unmapped with the last of them.
+    std::shared_ptr<const void> mapping;
+    Mapped mapped;
+
+    inline bool is_mapped() const { return mapping != nullptr; }
+    inline size_t nbits() const { return is_mapped() ? mapped.nbits : bits.size(); }
+    inline const uint64_t* bits_data() const { return is_mapped() ? mapped.bits : bits.data(); }
+    inline size_t size() const { return is_mapped() ? mapped.ncells : tags.size(); }
+    inline uint8_t tag_at(size_t i) const { return is_mapped() ? mapped.tags[i] : tags[i]; }
+    inline uint64_t value_at(size_t i) const {
+        return is_mapped() ? mapped.values[i] : values[i];
+    }
+    inline const char* text_data() const { return is_mapped() ? mapped.text : text.data(); }
+    inline size_t text_size() const { return is_mapped() ? mapped.ntext : text.size(); }
+
+    inline
+    void set(int row, uint8_t tag, uint64_t value) {
+        size_t word = row >> 6;
+        uint64_t bit = uint64_t(1) << (row & 63);
+        if (row > last_row) {
+            if (word >= bits.size()) bits.resize(word + 1, 0);
+            bits[word] |= bit;
+            tags.push_back(tag);
+            values.push_back(value);
+            last_row = row;
+            return;
+        }
+        // out of order, or a duplicated cell. rare.
+        size_t idx = 0;
+        for (size_t w = 0; w < word; ++w) idx += popcount(bits[w]);
+        idx += popcount(bits[word] & (bit - 1));
+        if (bits[word] & bit) {
+            tags[idx] = tag;
+            values[idx] = value;
+            return;
+        }
+        bits[word] |= bit;
+        tags.insert(tags.begin() + idx, tag);
+        values.insert(values.begin() + idx, value);
+    }
+
+    inline
+    void set_text(int row, uint8_t tag, const std::string& s) {
+        if (text.size() + s.size() > UINT32_MAX) {
+            throw Exception("too large column text. row=", row);
+        }
+        uint64_t value = (uint64_t(text.size()) << 32) | s.size();
+        text.append(s);
+        set(row, tag | kTextTag, value);
+    }
+
+    // text with a binary value in front of it.
+    inline
+    void set_number(int row, uint8_t tag, const std::string& s, uint64_t number) {
+        char bytes[sizeof(number)];
+        std::memcpy(bytes, &number, sizeof(number));
+        text.append(bytes, sizeof(bytes));
+        set_text(row, tag | kNumberTag, s);
+    }
+
+    // moves the cells of other, which are all below the cells of this.
+    inline
+    void append(ColumnStore& other) {
+        if (text.size() + other.text.size() > UINT32_MAX) {
+            throw Exception("too large column text. row=", other.last_row);
+        }
+        if (bits.size() < other.bits.size()) bits.resize(other.bits.size(), 0);
+        for (size_t w = 0; w < other.bits.size(); ++w) {
+            bits[w] |= other.bits[w];
+        }
+        uint64_t base = uint64_t(text.size()) << 32;
+        text.append(other.text);
+        tags.insert(tags.end(), other.tags.begin(), other.tags.end());
+        values.reserve(values.size() + other.values.size());
+        for (size_t i = 0; i < other.values.size(); ++i) {
+            values.push_back(other.tags[i] & kTextTag ? other.values[i] + base : other.values[i]);
+        }
+        if (other.last_row > last_row) last_row = other.last_row;
+        other = ColumnStore();
+    }
+
+    // builds the rank directory. call after all cells are set.
+    inline
+    void finish() {
+        auto words = bits_data();
+        ranks.resize(nbits());
+        uint32_t n = 0;
+        for (size_t w = 0; w < ranks.size(); ++w) {
+            ranks[w] = n;
+            n += popcount(words[w]);
+        }
+        tags.shrink_to_fit();
+        values.shrink_to_fit();
+        text.shrink_to_fit();
+    }
+
+    // first row which has a cell, or -1.
+    inline
+    int first_row() const {
+        auto words = bits_data();
+        for (size_t w = 0; w < nbits(); ++w) {
+            if (words[w] != 0) return static_cast<int>(w * 64 + __builtin_ctzll(words[w]));
+        }
+        return -1;
+    }
+
+    // index of the cell at row, or -1.
+    inline
+    int64_t find(int row) const {
+        size_t word = row >> 6;
+        uint64_t bit = uint64_t(1) << (row & 63);
+        if (word >= nbits()) return -1;
+        uint64_t w = bits_data()[word];
+        if ((w & bit) == 0) return -1;
+        return ranks[word] + popcount(w & (bit - 1));
+    }
+
+    inline
+    StringRef text_at(size_t idx) const {
+        uint64_t value = value_at(idx);
+        return StringRef(text_data() + (value >> 32), value & 0xFFFFFFFF);
+    }
+
+    // binary value of a cell set by set_number().
+    inline
+    uint64_t number_at(size_t idx) const {
+        uint64_t number;
+        std::memcpy(&number, text_data() + (value_at(idx) >> 32) - sizeof(number),
+                    sizeof(number));
+        return number;
+    }
+
+    // bytes on the heap. a mapping is in the page cache, and not counted.
+    inline
+    size_t memory_usage() const {
+        return bits.capacity() * sizeof(uint64_t) + ranks.capacity() * sizeof(uint32_t) +
+               tags.capacity() + values.capacity() * sizeof(uint64_t) + text.capacity();
+    }
+
+    static inline
+    int popcount(uint64_t x) {
+        return __builtin_popcountll(x);
+    }
+};
+
+}  // namespace xlsx
@@ -0,0 +1,144 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include <extlibs/zlib/zlib.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define XLSX_CRC32_CLMUL 1
+#endif
+
+namespace xlsx {
+
+// crc32 of zip entries. the sse4.2 crc32 instruction is of another polynomial (crc32c),
+// so blocks of 64 bytes are folded with pclmulqdq instead, and the rest is left to zlib.
+// SEE: Intel, "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+// pclmulqdq is chosen at runtime. zlib's table is the reference and the fallback.
+struct Crc32 {
+    enum class Level { kTable, kClmul };
+    static const size_t kClmulMinSize = 64;
+
+    using Update = uint32_t (*)(uint32_t, const char*, size_t);
+
+    static inline
+    uint32_t update_table(uint32_t crc, const char* p, size_t n) {
+        // zlib takes uInt sizes.
+        while (n > 0) {
+            uInt len = n > (1u << 30) ? (1u << 30) : static_cast<uInt>(n);
+            crc = static_cast<uint32_t>(crc32(crc, reinterpret_cast<const Bytef*>(p), len));
+            p += len;
+            n -= len;
+        }
+        return crc;
+    }
+
+#ifdef XLSX_CRC32_CLMUL
+    // x * k folded onto next.
+    __attribute__((target("sse4.1,pclmul"))) static inline
+    __m128i fold16(__m128i x, __m128i k, __m128i next) {
+        __m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+        __m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+        return _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+    }
+
+    __attribute__((target("sse4.1,pclmul"))) static inline
+    __m128i load(const char* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+
+    // n is a multiple of 16, and at least 64. crc is not inverted.
+    // constants are x^k mod P, bit-reflected, from the paper.
+    __attribute__((target("sse4.1,pclmul"))) static inline
+    uint32_t fold(uint32_t crc, const char* p, size_t n) {
+        const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+        const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+        const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+        const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+        const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+        __m128i x1 = _mm_xor_si128(load(p), _mm_cvtsi32_si128(static_cast<int>(crc)));
+        __m128i x2 = load(p + 16);
+        __m128i x3 = load(p + 32);
+        __m128i x4 = load(p + 48);
+        p += 64;
+        n -= 64;
+        // four lanes of 128 bits, each folded 512 bits ahead.
+        for (; n >= 64; p += 64, n -= 64) {
+            x1 = fold16(x1, k1k2, load(p));
+            x2 = fold16(x2, k1k2, load(p + 16));
+            x3 = fold16(x3, k1k2, load(p + 32));
+            x4 = fold16(x4, k1k2, load(p + 48));
+        }
+        // the lanes into one, then the remaining blocks of 16.
+        x1 = fold16(x1, k3k4, x2);
+        x1 = fold16(x1, k3k4, x3);
+        x1 = fold16(x1, k3k4, x4);
+        for (; n >= 16; p += 16, n -= 16) {
+            x1 = fold16(x1, k3k4, load(p));
+        }
+
+        // 128 to 64 bits.
+        __m128i t = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+        x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), t);
+        t = _mm_srli_si128(x1, 4);
+        x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), k5k0, 0x00);
+        x1 = _mm_xor_si128(x1, t);
+
+        // barrett reduction to 32 bits.
+        t = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), poly, 0x10);
+        t = _mm_clmulepi64_si128(_mm_and_si128(t, low32), poly, 0x00);
+        x1 = _mm_xor_si128(x1, t);
+        return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+    }
+
+    static inline
+    uint32_t update_clmul(uint32_t crc, const char* p, size_t n) {
+        if (n < kClmulMinSize) return update_table(crc, p, n);
+        size_t blocks = n & ~size_t(15);
+        crc = ~fold(~crc, p, blocks);
+        return update_table(crc, p + blocks, n - blocks);
+    }
+#endif
+
+    // the best level of this cpu.
+    static inline
+    Level detect() {
+#ifdef XLSX_CRC32_CLMUL
+        if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+            return Level::kClmul;
+        }
+#endif
+        return Level::kTable;
+    }
+
+    static inline
+    Update kernel(Level level) {
+#ifdef XLSX_CRC32_CLMUL
+        if (level == Level::kClmul) return update_clmul;
+#endif
+        (void)level;
+        return update_table;
+    }
+
+    static inline
+    Update& active() {
+        static Update f = kernel(detect());
+        return f;
+    }
+
+    // e.g. for a benchmark. not to be called while other threads compute.
+    static inline
+    void select(Level level) {
+        active() = kernel(level);
+    }
+
+    // crc of p[0..n) following crc, as zlib's crc32(). starts with 0.
+    static inline
+    uint32_t update(uint32_t crc, const char* p, size_t n) {
+        return active()(crc, p, n);
+    }
+};
+
+}  // namespace xlsx
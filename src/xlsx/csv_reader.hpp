@@ -0,0 +1,149 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "xlsx/exception.hpp"
+#include "xlsx/cell_ref.hpp"
+#include "xlsx/number.hpp"
+#include "xlsx/scan.hpp"
+#include "xlsx/sheet_reader.hpp"
+
+namespace xlsx {
+
+// records of a csv (RFC 4180) in memory, read into the same rows as SheetReader does.
+// a quoted field may have the delimiter, newlines and "" of a quote in it.
+// the end of an unquoted field is found by Scan::find3, and of a quoted one by memchr.
+// a number is a value as <v> is, and the other text is an inline string.
+// a row is a record, and a column is a field of it.
+struct CsvReader {
+    // a csv has no dimension. as many as a reference can have, until the records are read.
+    // a record of more fields than a sheet of excel has columns is an error, not cut.
+    static const int kMaxRows = 999999999;
+    static const int kMaxCols = 16384;
+
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+    char delimiter;
+    bool done = false;
+    std::string dimension;
+    // cells out of projection are skipped without copying the value. owned by caller.
+    const ColumnProjection* projection = nullptr;
+    // rows and cells out of bounds are skipped, and rows past them are not read.
+    const CellRange* bounds = nullptr;
+    int last_index = -1;
+    // extent of the records read.
+    int nrows = 0;
+    int ncols = 0;
+
+    inline
+    CsvReader(const char* data_, size_t size_, char delimiter_)
+            : data(data_), size(size_), delimiter(delimiter_) {
+        // utf-8 bom of excel.
+        if (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) pos = 3;
+        done = pos >= size;
+        dimension = "A1:" + CellRef::name(kMaxRows - 1, kMaxCols - 1);
+    }
+
+    inline
+    bool next_row(RawRow& row) {
+        row.clear();
+        while (!done) {
+            row.index = ++last_index;
+            if (bounds == nullptr || bounds->contains_row(row.index)) {
+                read_record(row);
+                return true;
+            }
+            // records are in order. the rest is out of bounds too.
+            if (bounds->last_row < row.index) break;
+            while (read_field(nullptr)) {}
+        }
+        finish();
+        return false;
+    }
+
+    // the dimension is the extent of the records read then.
+    inline
+    void finish() {
+        done = true;
+        dimension = "A1:" + CellRef::name(std::max(nrows, 1) - 1, std::max(ncols, 1) - 1);
+    }
+
+    inline
+    void read_record(RawRow& row) {
+        nrows = row.index + 1;
+        for (int colx = 0;; ++colx) {
+            if (colx >= kMaxCols) {
+                throw Exception("csv: too many fields. row=", row.index + 1, " max=", kMaxCols);
+            }
+            ncols = std::max(ncols, colx + 1);
+            bool skip = (bounds != nullptr && !bounds->contains_col(colx)) ||
+                        (projection != nullptr && !projection->contains(colx));
+            if (skip) {
+                if (!read_field(nullptr)) return;
+                continue;
+            }
+            auto& cell = row.push();
+            cell.col = colx;
+            bool more = read_field(&cell.v);
+            if (cell.v.empty()) {
+                // as a <c> without a value.
+                row.pop();
+            } else if (Number::parse(cell.v).kind == Number::Kind::kInvalid) {
+                cell.t = "inlineStr";
+            }
+            if (!more) return;
+        }
+    }
+
+    // a field from pos, appended to v unless it is nullptr.
+    // false if it is the last one of the record.
+    inline
+    bool read_field(std::string* v) {
+        const char* p = data + pos;
+        const char* e = data + size;
+        if (p < e && *p == '"') {
+            ++p;
+            while (true) {
+                auto q = static_cast<const char*>(std::memchr(p, '"', e - p));
+                if (q == nullptr) {
+                    // not closed. the rest is the field.
+                    if (v != nullptr) v->append(p, e - p);
+                    p = e;
+                    break;
+                }
+                if (v != nullptr) v->append(p, q - p);
+                if (q + 1 < e && q[1] == '"') {
+                    if (v != nullptr) v->push_back('"');
+                    p = q + 2;
+                    continue;
+                }
+                p = q + 1;
+                break;
+            }
+        }
+        // an unquoted field, or bytes after the closing quote which are kept as text.
+        auto q = Scan::find3(p, e, delimiter, '\n', '\r');
+        if (v != nullptr) v->append(p, q - p);
+        p = q;
+        if (p == e) {
+            pos = size;
+            done = true;
+            return false;
+        }
+        if (*p == delimiter) {
+            pos = p + 1 - data;
+            return true;
+        }
+        // \r\n, \n or \r.
+        if (*p == '\r' && p + 1 < e && p[1] == '\n') ++p;
+        pos = p + 1 - data;
+        done = pos >= size;
+        return false;
+    }
+};
+
+}  // namespace xlsx
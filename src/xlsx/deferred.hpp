@@ -0,0 +1,28 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+namespace xlsx {
+
+// runs load once, on first demand. once loaded, ensure() is a single acquire load.
+// if load throws, the next ensure() tries again.
+struct Deferred {
+    std::function<void()> load;
+    std::once_flag once;
+    std::atomic<bool> ready{false};
+
+    inline
+    void ensure() {
+        if (ready.load(std::memory_order_acquire)) return;
+        std::call_once(once, [this]() {
+            if (load) load();
+            load = nullptr;
+            ready.store(true, std::memory_order_release);
+        });
+    }
+};
+
+}  // namespace xlsx
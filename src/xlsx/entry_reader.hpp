@@ -0,0 +1,247 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <istream>
+#include <functional>
+
+#include <ZipFile.h>
+#include <extlibs/zlib/zlib.h>
+
+#include "xlsx/exception.hpp"
+#include "xlsx/zip_reader.hpp"
+#include "xlsx/crc32.hpp"
+
+namespace xlsx {
+
+// reads an entry from the raw (compressed) data and inflates it with zlib directly,
+// bypassing the decoder/crc streambuf chain of ZipLib.
+// the raw data comes from a mapped zip (ZipReader), or from ZipLib's raw stream.
+// other compression methods or encrypted entries fall back to GetDecompressionStream().
+// the crc32 of the central directory is checked once the whole entry has been read.
+struct EntryReader {
+    enum Mode {
+        kStored, kDeflated, kStream,
+    };
+    static const size_t kChunkSize = 64 * 1024;
+    static const uint16_t kStoreMethod = 0;
+    static const uint16_t kDeflateMethod = 8;
+
+    std::string name;
+    size_t size_ = 0;
+    Mode mode = Mode::kStream;
+    // ZipLib
+    ZipArchiveEntry::Ptr entry;
+    std::istream* stream = nullptr;
+    std::vector<char> in;
+    // ZipReader
+    const char* mapped = nullptr;
+    uint64_t mapped_size = 0;
+    uint64_t mapped_pos = 0;
+
+    z_stream zs;
+    bool inflating = false;
+    bool finished = false;
+
+    uint32_t expected_crc = 0;
+    uint32_t crc = 0;
+    bool verify = true;
+    bool checked = false;
+    // called once the crc has matched.
+    std::function<void()> on_verified;
+
+    inline
+    explicit EntryReader(ZipArchiveEntry::Ptr entry_)
+            : name(entry_->GetFullName()), size_(entry_->GetSize()), entry(entry_) {
+        bool encrypted = entry->IsPasswordProtected();
+        auto method = entry->GetCompressionMethod();
+        if (!encrypted && method == kStoreMethod) {
+            mode = Mode::kStored;
+            stream = entry->GetRawStream();
+        } else if (!encrypted && method == kDeflateMethod) {
+            mode = Mode::kDeflated;
+            stream = entry->GetRawStream();
+            in.resize(kChunkSize);
+        } else {
+            // ZipLib checks it by itself.
+            mode = Mode::kStream;
+            stream = entry->GetDecompressionStream();
+            verify = false;
+        }
+        expected_crc = entry->GetCrc32();
+        if (stream == nullptr) {
+            close();
+            throw Exception("entry=", name, ": cant decode stream.");
+        }
+        if (mode == Mode::kDeflated) init_inflate();
+    }
+
+    inline
+    EntryReader(ZipReader& zip, size_t index) {
+        auto& e = zip.entries.at(index);
+        name = e.name.str();
+        size_ = e.size;
+        if (zip.is_encrypted(e)) {
+            throw Exception("entry=", name, ": encrypted entry is not supported.");
+        }
+        if (e.method == kStoreMethod) {
+            mode = Mode::kStored;
+            if (e.compressed_size != e.size) {
+                throw Exception("entry=", name, ": broken stored entry.");
+            }
+        } else if (e.method == kDeflateMethod) {
+            mode = Mode::kDeflated;
+        } else {
+            throw Exception("entry=", name, ": compression method=", e.method,
+                            " is not supported.");
+        }
+        mapped = zip.data(e);
+        mapped_size = e.compressed_size;
+        expected_crc = e.crc32;
+        if (mode == Mode::kDeflated) init_inflate();
+    }
+
+    inline
+    ~EntryReader() {
+        close();
+    }
+
+    EntryReader(const EntryReader&) = delete;
+    EntryReader& operator=(const EntryReader&) = delete;
+
+    inline
+    void init_inflate() {
+        zs = z_stream();
+        if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+            close();
+            throw Exception("entry=", name, ": inflateInit failed.");
+        }
+        inflating = true;
+    }
+
+    inline
+    void close() {
+        if (inflating) inflateEnd(&zs);
+        inflating = false;
+        stream = nullptr;
+        mapped = nullptr;
+        if (entry) {
+            entry->CloseRawStream();
+            entry->CloseDecompressionStream();
+        }
+    }
+
+    inline
+    size_t size() const {
+        return size_;
+    }
+
+    // whole content in the mapped memory, if the entry is stored. or nullptr.
+    inline
+    const char* stored_data() {
+        if (mode != Mode::kStored || mapped == nullptr) return nullptr;
+        if (verify && !checked) {
+            crc = Crc32::update(0, mapped, mapped_size);
+            check();
+        }
+        return mapped;
+    }
+
+    inline
+    void check() {
+        if (!verify || checked) return;
+        checked = true;
+        if (crc != expected_crc) {
+            throw Exception("entry=", name, ": crc mismatch. expect=", expected_crc,
+                            " actual=", crc);
+        }
+        if (on_verified) on_verified();
+    }
+
+    // reads the rest of the entry to check the crc, after a reader has stopped at its data.
+    inline
+    void finish() {
+        if (!verify || checked) return;
+        char buf[4096];
+        while (read(buf, sizeof(buf)) != 0) {}
+    }
+
+    // returns 0 at the end of entry.
+    inline
+    size_t read(char* dst, size_t n) {
+        if (mode != Mode::kDeflated) {
+            size_t r = 0;
+            if (mapped != nullptr) {
+                r = std::min<uint64_t>(n, mapped_size - mapped_pos);
+                std::memcpy(dst, mapped + mapped_pos, r);
+                mapped_pos += r;
+            } else if (stream != nullptr) {
+                stream->read(dst, n);
+                r = static_cast<size_t>(stream->gcount());
+            }
+            if (verify) {
+                crc = Crc32::update(crc, dst, r);
+                if (r == 0 || (mapped != nullptr && mapped_pos == mapped_size)) check();
+            }
+            return r;
+        }
+        if (finished || !inflating) return 0;
+        zs.next_out = reinterpret_cast<Bytef*>(dst);
+        zs.avail_out = static_cast<uInt>(n);
+        while (zs.avail_out > 0) {
+            if (zs.avail_in == 0) feed();
+            int ret = inflate(&zs, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                finished = true;
+                break;
+            }
+            if (ret != Z_OK) {
+                throw Exception("entry=", name, ": inflate error=", ret);
+            }
+        }
+        size_t r = n - zs.avail_out;
+        if (verify) {
+            crc = Crc32::update(crc, dst, r);
+            if (finished) check();
+        }
+        return r;
+    }
+
+    inline
+    void feed() {
+        if (mapped != nullptr) {
+            // inflate straight from the mapped memory.
+            uint64_t got = std::min<uint64_t>(mapped_size - mapped_pos, 1 << 30);
+            if (got == 0) throw Exception("entry=", name, ": unexpected eof.");
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(mapped + mapped_pos));
+            zs.avail_in = static_cast<uInt>(got);
+            mapped_pos += got;
+            return;
+        }
+        stream->read(in.data(), in.size());
+        auto got = stream->gcount();
+        if (got <= 0) throw Exception("entry=", name, ": unexpected eof.");
+        zs.next_in = reinterpret_cast<Bytef*>(in.data());
+        zs.avail_in = static_cast<uInt>(got);
+    }
+
+    // reads whole entry into dst. dst must have size() bytes.
+    inline
+    void read_all(char* dst) {
+        size_t n = 0;
+        while (n < size_) {
+            auto r = read(dst + n, size_ - n);
+            if (r == 0) break;
+            n += r;
+        }
+        char c;
+        if (n != size_ || read(&c, 1) != 0) {
+            throw Exception("entry=", name, ": size mismatch. expect=", size_);
+        }
+    }
+};
+
+}  // namespace xlsx
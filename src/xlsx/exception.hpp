@@ -0,0 +1,33 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <string>
+#include <sstream>
+#include <stdexcept>
+
+namespace xlsx {
+
+template<class T>
+void sscat_detail_(std::stringstream& ss, const T& t) {
+    ss << t;
+}
+
+template<class T, class...A>
+void sscat_detail_(std::stringstream& ss, const T& t, const A&...a) {
+    ss << t;
+    sscat_detail_(ss, a...);
+}
+
+template<class...A>
+std::string sscat(const A&...a) {
+    auto ss = std::stringstream();
+    sscat_detail_(ss, a...);
+    return ss.str();
+}
+
+struct Exception: std::runtime_error {
+    template<class...A>
+    inline explicit Exception(A...a) : std::runtime_error(sscat(a...).c_str()) {}
+};
+
+}  // namespace xlsx
@@ -0,0 +1,154 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace xlsx {
+
+// numeric value of <v>, classified and parsed in one pass without exceptions.
+//   kInt: [+-]digits, fits in int64. (-0 is left to the slow path, it is -0.0 as double)
+//   kDouble: [+-]digits[.digits][(e|E)[+-]digits], at least one digit in the mantissa.
+//   kInvalid: anything else, incl. int64 overflow and double out of range.
+struct Number {
+    enum Kind {
+        kInvalid, kInt, kDouble,
+    };
+
+    Kind kind = Kind::kInvalid;
+    int64_t i = 0;
+    double d = 0.0;
+
+    static inline
+    Number parse(const std::string& s) {
+        return parse(s.data(), s.data() + s.size());
+    }
+
+    static inline
+    Number parse(const char* begin, const char* end) {
+        Number n;
+        const char* p = begin;
+        bool negative = false;
+        if (p < end && (*p == '+' || *p == '-')) {
+            negative = *p == '-';
+            ++p;
+        }
+        // mantissa. the first 19 significant digits are exact in uint64.
+        uint64_t m = 0;
+        int ndigits = 0;
+        int exp10 = 0;
+        int nsignificant = 0;
+        const char* q = p;
+        for (; q < end && is_digit(*q); ++q) {
+            if (nsignificant < 19) {
+                m = m * 10 + (*q - '0');
+                if (m != 0) ++nsignificant;
+            } else {
+                ++exp10;
+                ++nsignificant;
+            }
+        }
+        ndigits = static_cast<int>(q - p);
+        bool is_float = false;
+        if (q < end && *q == '.') {
+            is_float = true;
+            const char* f = ++q;
+            for (; q < end && is_digit(*q); ++q) {
+                if (nsignificant < 19) {
+                    m = m * 10 + (*q - '0');
+                    --exp10;
+                    if (m != 0) ++nsignificant;
+                } else {
+                    ++nsignificant;
+                }
+            }
+            ndigits += static_cast<int>(q - f);
+        }
+        if (ndigits == 0) return n;
+        if (q < end && (*q == 'e' || *q == 'E')) {
+            is_float = true;
+            ++q;
+            bool exp_negative = false;
+            if (q < end && (*q == '+' || *q == '-')) {
+                exp_negative = *q == '-';
+                ++q;
+            }
+            if (q == end) return n;
+            int e = 0;
+            for (; q < end && is_digit(*q); ++q) {
+                if (e < 100000) e = e * 10 + (*q - '0');
+            }
+            exp10 += exp_negative ? -e : e;
+        }
+        if (q != end) return n;
+
+        if (!is_float) {
+            // plain integer. nsignificant > 19 overflows.
+            if (nsignificant > 19 || m > uint64_t(INT64_MAX) + (negative ? 1 : 0)) return n;
+            if (negative && m == 0) return n;
+            n.kind = Kind::kInt;
+            n.i = negative ? static_cast<int64_t>(0 - m) : static_cast<int64_t>(m);
+            n.d = static_cast<double>(n.i);
+            return n;
+        }
+        n.kind = Kind::kDouble;
+        // exact when both the mantissa and the power of ten are exact doubles. (Clinger)
+        static const double kPow10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+        };
+        if (nsignificant <= 19 && m <= (uint64_t(1) << 53) && -22 <= exp10 && exp10 <= 22) {
+            double d = static_cast<double>(m);
+            d = exp10 < 0 ? d / kPow10[-exp10] : d * kPow10[exp10];
+            n.d = negative ? -d : d;
+            return n;
+        }
+        // out of range is left to the slow path too.
+        if (!slow_double(begin, end, n.d)) n.kind = Kind::kInvalid;
+        return n;
+    }
+
+    static inline
+    bool is_digit(char c) {
+        return '0' <= c && c <= '9';
+    }
+
+    // correctly rounded by strtod, for long mantissas or large exponents.
+    static inline
+    bool slow_double(const char* begin, const char* end, double& out) {
+        char buf[64];
+        size_t len = end - begin;
+        errno = 0;
+        if (len < sizeof(buf)) {
+            std::memcpy(buf, begin, len);
+            buf[len] = '\0';
+            out = std::strtod(buf, nullptr);
+        } else {
+            out = std::strtod(std::string(begin, end).c_str(), nullptr);
+        }
+        return errno != ERANGE;
+    }
+
+    // leading integer of s, as std::stoll reads it. false if there is none or it overflows.
+    static inline
+    bool parse_int_prefix(const char* p, const char* end, int64_t& out) {
+        bool negative = false;
+        if (p < end && (*p == '+' || *p == '-')) {
+            negative = *p == '-';
+            ++p;
+        }
+        if (p == end || !is_digit(*p)) return false;
+        uint64_t m = 0;
+        for (int n = 0; p < end && is_digit(*p); ++p, ++n) {
+            if (n >= 18) return false;
+            m = m * 10 + (*p - '0');
+        }
+        out = negative ? -static_cast<int64_t>(m) : static_cast<int64_t>(m);
+        return true;
+    }
+};
+
+}  // namespace xlsx
@@ -0,0 +1,239 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <cstring>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XLSX_SCAN_SSE2 1
+#endif
+#if defined(XLSX_SCAN_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define XLSX_SCAN_AVX2 1
+#endif
+
+namespace xlsx {
+
+// byte scanning kernels of the xml tokenizer.
+// markup of a sheet is short runs between '<', '"' and '&', so the tokenizer looks for the
+// first of a few bytes at a time, 16 (sse2) or 32 (avx2) bytes per step.
+// avx2 is chosen at runtime. the scalar one is the reference and the fallback.
+struct Scan {
+    enum class Level { kScalar, kSse2, kAvx2 };
+    // bytes scanned inline before the kernel. <c r="AB12" s="3" t="s"> fits in a head.
+    static const int kFind3Head = 16;
+    static const int kTagEndHead = 32;
+
+    // first of a, b or c in [p, e), or e.
+    using Find3 = const char* (*)(const char*, const char*, char, char, char);
+    // first '>' out of quoted values in [p, e), or e.
+    using TagEnd = const char* (*)(const char*, const char*);
+
+    struct Kernels {
+        Find3 find3;
+        TagEnd tag_end;
+    };
+
+    // bytes in quoted values, from the quote bits of a block. bit i is the xor of bits 0..i.
+    static inline
+    uint32_t prefix_xor(uint32_t x) {
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        return x;
+    }
+
+    // bit of the end in a block, or -1. quote is the one open across blocks.
+    // -2 if both kinds of quote are in it, which is left to the byte loop.
+    static inline
+    int block_end(uint32_t gt, uint32_t dq, uint32_t sq, char& quote) {
+        uint32_t q = dq | sq;
+        char kind = dq != 0 ? '"' : '\'';
+        if ((dq != 0 && sq != 0) || (quote != 0 && q != 0 && kind != quote)) return -2;
+        uint32_t in = prefix_xor(q) ^ (quote != 0 ? ~0u : 0u);
+        uint32_t m = gt & ~in;
+        if (m != 0) return __builtin_ctz(m);
+        if (__builtin_popcount(q) & 1) quote = quote != 0 ? 0 : kind;
+        return -1;
+    }
+
+    static inline
+    const char* tag_end_bytes(const char* p, const char* e, char& quote) {
+        for (; p < e; ++p) {
+            char c = *p;
+            if (quote != 0) {
+                if (c == quote) quote = 0;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '>') {
+                return p;
+            }
+        }
+        return e;
+    }
+
+    static inline
+    const char* find3_scalar(const char* p, const char* e, char a, char b, char c) {
+        for (; p < e; ++p) {
+            char x = *p;
+            if (x == a || x == b || x == c) return p;
+        }
+        return e;
+    }
+
+    static inline
+    const char* tag_end_scalar(const char* p, const char* e) {
+        char quote = 0;
+        return tag_end_bytes(p, e, quote);
+    }
+
+#ifdef XLSX_SCAN_SSE2
+    static inline
+    uint32_t mask16(__m128i x, char c) {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(c))));
+    }
+
+    static inline
+    const char* tag_end_sse2(const char* p, const char* e, char& quote) {
+        for (; e - p >= 16; p += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            int i = block_end(mask16(x, '>'), mask16(x, '"'), mask16(x, '\''), quote);
+            if (i >= 0) return p + i;
+            if (i == -2) {
+                auto q = tag_end_bytes(p, p + 16, quote);
+                if (q != p + 16) return q;
+            }
+        }
+        return tag_end_bytes(p, e, quote);
+    }
+
+    static inline
+    const char* tag_end_sse2(const char* p, const char* e) {
+        char quote = 0;
+        return tag_end_sse2(p, e, quote);
+    }
+
+    static inline
+    const char* find3_sse2(const char* p, const char* e, char a, char b, char c) {
+        const __m128i va = _mm_set1_epi8(a);
+        const __m128i vb = _mm_set1_epi8(b);
+        const __m128i vc = _mm_set1_epi8(c);
+        for (; e - p >= 16; p += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)),
+                                     _mm_cmpeq_epi8(x, vc));
+            int mask = _mm_movemask_epi8(m);
+            if (mask != 0) return p + __builtin_ctz(mask);
+        }
+        return find3_scalar(p, e, a, b, c);
+    }
+#endif
+
+#ifdef XLSX_SCAN_AVX2
+    __attribute__((target("avx2"))) static inline
+    const char* find3_avx2(const char* p, const char* e, char a, char b, char c) {
+        const __m256i va = _mm256_set1_epi8(a);
+        const __m256i vb = _mm256_set1_epi8(b);
+        const __m256i vc = _mm256_set1_epi8(c);
+        for (; e - p >= 32; p += 32) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i m = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb)),
+                _mm256_cmpeq_epi8(x, vc));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(m));
+            if (mask != 0) return p + __builtin_ctz(mask);
+        }
+        return find3_sse2(p, e, a, b, c);
+    }
+
+    __attribute__((target("avx2"))) static inline
+    uint32_t mask32(__m256i x, char c) {
+        return static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(c))));
+    }
+
+    __attribute__((target("avx2"))) static inline
+    const char* tag_end_avx2(const char* p, const char* e) {
+        char quote = 0;
+        for (; e - p >= 32; p += 32) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            int i = block_end(mask32(x, '>'), mask32(x, '"'), mask32(x, '\''), quote);
+            if (i >= 0) return p + i;
+            if (i == -2) {
+                auto q = tag_end_bytes(p, p + 32, quote);
+                if (q != p + 32) return q;
+            }
+        }
+        return tag_end_sse2(p, e, quote);
+    }
+#endif
+
+    // the best level of this cpu.
+    static inline
+    Level detect() {
+#ifdef XLSX_SCAN_AVX2
+        if (__builtin_cpu_supports("avx2")) return Level::kAvx2;
+#endif
+#ifdef XLSX_SCAN_SSE2
+        return Level::kSse2;
+#else
+        return Level::kScalar;
+#endif
+    }
+
+    // a level this build does not have falls back to the next one.
+    static inline
+    Kernels kernels(Level level) {
+#ifdef XLSX_SCAN_AVX2
+        if (level == Level::kAvx2) return Kernels{find3_avx2, tag_end_avx2};
+#endif
+#ifdef XLSX_SCAN_SSE2
+        if (level != Level::kScalar) return Kernels{find3_sse2, tag_end_sse2};
+#endif
+        return Kernels{find3_scalar, tag_end_scalar};
+    }
+
+    static inline
+    Kernels& active() {
+        static Kernels k = kernels(detect());
+        return k;
+    }
+
+    // e.g. for a benchmark. not to be called while other threads scan.
+    static inline
+    void select(Level level) {
+        active() = kernels(level);
+    }
+
+    // most hits in markup are a few bytes away. those are found inline by the byte loop,
+    // and only a longer run goes to the kernel.
+    static inline
+    const char* find3(const char* p, const char* e, char a, char b, char c) {
+        auto head = e - p < kFind3Head ? e : p + kFind3Head;
+        for (; p < head; ++p) {
+            char x = *p;
+            if (x == a || x == b || x == c) return p;
+        }
+        return p == e ? e : active().find3(p, e, a, b, c);
+    }
+
+    static inline
+    const char* tag_end(const char* p, const char* e) {
+        auto head = e - p < kTagEndHead ? e : p + kTagEndHead;
+        char quote = 0;
+        auto q = tag_end_bytes(p, head, quote);
+        if (q != head || head == e) return q;
+        if (quote != 0) {
+            // finish the open value, then it is a fresh scan.
+            q = static_cast<const char*>(std::memchr(head, quote, e - head));
+            if (q == nullptr) return e;
+            head = q + 1;
+        }
+        return active().tag_end(head, e);
+    }
+};
+
+}  // namespace xlsx
@@ -0,0 +1,310 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <future>
+
+#include "xlsx/exception.hpp"
+#include "xlsx/deferred.hpp"
+#include "xlsx/xml_reader.hpp"
+#include "xlsx/string_ref.hpp"
+#include "xlsx/thread_budget.hpp"
+
+namespace xlsx {
+
+// append-only character storage.
+// strings are never moved once stored, so views of them stay valid for the arena's lifetime.
+struct StringArena {
+    static const size_t kBlockSize = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* block = nullptr;
+    size_t block_pos = 0;
+    std::mutex mutex;
+
+    inline
+    const char* store(const char* p, size_t n) {
+        std::lock_guard<std::mutex> lock(mutex);
+        char* dst;
+        if (n > kBlockSize / 4) {
+            // large one gets its own block.
+            blocks.emplace_back(new char[n]);
+            dst = blocks.back().get();
+        } else {
+            if (block == nullptr || block_pos + n > kBlockSize) {
+                blocks.emplace_back(new char[kBlockSize]);
+                block = blocks.back().get();
+                block_pos = 0;
+            }
+            dst = block + block_pos;
+            block_pos += n;
+        }
+        std::memcpy(dst, p, n);
+        return dst;
+    }
+};
+
+// shared string table of xl/sharedStrings.xml, decoded on demand.
+// the constructor only scans the part for the offset of each <si>.
+// an entry is resolved when it is referenced first, into a view of the raw xml if it is
+// plain text, or of the arena if it has entities or runs. no string is allocated per entry.
+// readers may race on the same entry. the first published view is kept.
+// with a loader, even the part itself is read on first use.
+// a large table is split at <si> and scanned for the offsets on several threads as it loads.
+// its entries are decoded on demand all the same.
+struct SharedStrings {
+    // a table smaller than this is scanned on one thread.
+    static const size_t kParallelIndexSize = 16 * 1024 * 1024;
+
+    std::string xml;
+    std::vector<size_t> offsets;
+    // resolved views. nullptr until first reference.
+    std::unique_ptr<std::atomic<const char*>[]> ptrs;
+    std::unique_ptr<std::atomic<size_t>[]> sizes;
+    StringArena arena;
+    Deferred deferred;
+
+    inline
+    SharedStrings() {
+        deferred.ensure();
+    }
+
+    inline
+    explicit SharedStrings(std::string xml_) {
+        load_xml(std::move(xml_));
+        deferred.ensure();
+    }
+
+    // the table is filled by loader on first use, e.g. with load_xml() or assign().
+    inline
+    explicit SharedStrings(std::function<void(SharedStrings&)> loader) {
+        deferred.load = [this, loader]() { loader(*this); };
+    }
+
+    SharedStrings(const SharedStrings&) = delete;
+    SharedStrings& operator=(const SharedStrings&) = delete;
+
+    inline
+    void load_xml(std::string xml_, int nthreads = 1) {
+        xml = std::move(xml_);
+        if (nthreads > 1 && xml.size() >= kParallelIndexSize && index_parallel(nthreads)) {
+            return;
+        }
+        index();
+    }
+
+    // a loader which threw may run again. offsets of the last try are dropped.
+    inline
+    void index() {
+        offsets.clear();
+        scan(0, xml.size(), offsets);
+        allocate();
+    }
+
+    inline
+    void allocate() {
+        ptrs.reset(new std::atomic<const char*>[offsets.size()]());
+        sizes.reset(new std::atomic<size_t>[offsets.size()]());
+    }
+
+    // scans chunks of the table on this thread and idle ones of the process.
+    // false if a chunk has a comment or CDATA, where a split may have fallen. nothing is kept.
+    inline
+    bool index_parallel(int nthreads) {
+        ThreadBudget::Lease lease(ThreadBudget::global(), nthreads - 1);
+        if (lease.n == 0) return false;
+        auto chunks = split(lease.n + 1);
+        if (chunks.size() <= 2) return false;
+        size_t n = chunks.size() - 1;
+        std::vector<std::vector<size_t>> parts(n);
+        std::vector<uint8_t> plain(n, 0);
+        auto scan_chunk = [&](size_t k) {
+            plain[k] = scan(chunks[k], chunks[k + 1], parts[k]);
+        };
+        std::vector<std::future<void>> tasks;
+        for (size_t k = 1; k < n; ++k) {
+            tasks.push_back(std::async(std::launch::async, scan_chunk, k));
+        }
+        scan_chunk(0);
+        for (auto& task : tasks) task.get();
+        for (size_t k = 0; k < n; ++k) {
+            if (!plain[k]) return false;
+        }
+        size_t total = 0;
+        for (auto& part : parts) total += part.size();
+        offsets.clear();
+        offsets.reserve(total);
+        for (auto& part : parts) offsets.insert(offsets.end(), part.begin(), part.end());
+        allocate();
+        return true;
+    }
+
+    // boundaries of about n chunks, each starting at <si. the last one is the end.
+    inline
+    std::vector<size_t> split(int n) {
+        std::vector<size_t> chunks;
+        for (int k = 0; k < n; ++k) {
+            size_t p = k == 0 ? 0 : xml.size() / n * k;
+            if (k > 0) {
+                while ((p = xml.find("<si", p)) != std::string::npos) {
+                    char c = p + 3 < xml.size() ? xml[p + 3] : '\0';
+                    if (c == '>' || c == '/' || XmlReader::isspace(c)) break;
+                    ++p;
+                }
+                if (p == std::string::npos) break;
+            }
+            if (!chunks.empty() && chunks.back() >= p) continue;
+            chunks.push_back(p);
+        }
+        chunks.push_back(xml.size());
+        return chunks;
+    }
+
+    // decoded strings, e.g. of a binary workbook. all of them are resolved here.
+    inline
+    void assign(const std::vector<std::string>& strings) {
+        offsets.assign(strings.size(), 0);
+        ptrs.reset(new std::atomic<const char*>[strings.size()]());
+        sizes.reset(new std::atomic<size_t>[strings.size()]());
+        for (size_t i = 0; i < strings.size(); ++i) {
+            auto& s = strings[i];
+            sizes[i].store(s.size(), std::memory_order_relaxed);
+            ptrs[i].store(s.empty() ? "" : arena.store(s.data(), s.size()),
+                          std::memory_order_release);
+        }
+    }
+
+    inline
+    bool loaded() const {
+        return deferred.ready.load(std::memory_order_acquire);
+    }
+
+    inline
+    size_t size() {
+        deferred.ensure();
+        return offsets.size();
+    }
+
+    inline
+    StringRef at(size_t i) {
+        deferred.ensure();
+        if (i >= offsets.size()) {
+            throw Exception("invalid shared_string: invalid id=", i);
+        }
+        auto p = ptrs[i].load(std::memory_order_acquire);
+        if (p != nullptr) return StringRef(p, sizes[i].load(std::memory_order_relaxed));
+
+        auto ref = resolve(offsets[i], arena);
+        // racing writers store the same size.
+        sizes[i].store(ref.size, std::memory_order_relaxed);
+        const char* expected = nullptr;
+        if (!ptrs[i].compare_exchange_strong(expected, ref.data, std::memory_order_acq_rel,
+                                             std::memory_order_acquire)) {
+            ref.data = expected;
+        }
+        return ref;
+    }
+
+    inline
+    StringRef resolve(size_t offset, StringArena& arena_) {
+        static thread_local std::string text;
+        text.clear();
+        size_t raw_begin = 0, raw_end = 0;
+        int runs = decode(offset, text, raw_begin, raw_end);
+        if (text.empty()) return StringRef("", 0);
+        if (runs == 1 && raw_end - raw_begin == text.size() &&
+            std::memcmp(xml.data() + raw_begin, text.data(), text.size()) == 0) {
+            // nothing was unescaped. refer to the xml as it is.
+            return StringRef(xml.data() + raw_begin, text.size());
+        }
+        return StringRef(arena_.store(text.data(), text.size()), text.size());
+    }
+
+    // records the offset of each <si> in [pos, size), without decoding.
+    // text and attribute values cannot contain a raw '<', so jumping from '<' to '<' is enough.
+    // false if it met a comment or CDATA.
+    inline
+    bool scan(size_t pos, size_t size, std::vector<size_t>& out) {
+        const char* data = xml.data();
+        bool plain = true;
+        while (pos < size) {
+            auto p = static_cast<const char*>(std::memchr(data + pos, '<', size - pos));
+            if (p == nullptr) break;
+            pos = p - data;
+            if (pos + 1 >= size) break;
+            char c = data[pos + 1];
+            if (c == '/') {
+                pos += 2;
+            } else if (c == '?') {
+                pos = skip(pos, "?>");
+            } else if (c == '!') {
+                plain = false;
+                if (xml.compare(pos, 4, "<!--") == 0) {
+                    pos = skip(pos, "-->");
+                } else if (xml.compare(pos, 9, "<![CDATA[") == 0) {
+                    pos = skip(pos, "]]>");
+                } else {
+                    pos = skip(pos, ">");
+                }
+            } else {
+                size_t b = pos + 1;
+                size_t e = b;
+                while (e < size && !XmlReader::isspace(data[e]) &&
+                       data[e] != '/' && data[e] != '>') {
+                    if (data[e] == ':') b = e + 1;
+                    ++e;
+                }
+                if (e - b == 2 && data[b] == 's' && data[b + 1] == 'i') {
+                    out.push_back(pos);
+                }
+                pos = e;
+            }
+        }
+        return plain;
+    }
+
+    inline
+    size_t skip(size_t pos, const char* term) {
+        auto p = xml.find(term, pos);
+        if (p == std::string::npos) {
+            throw Exception("sharedStrings: unexpected eof. expect ", term);
+        }
+        return p + std::strlen(term);
+    }
+
+    // <si><t>..</t></si>, or rich text <si><r><t>..</t></r>..</si>. phonetic runs are ignored.
+    // returns the number of <t>, and the raw range of the last one.
+    inline
+    int decode(size_t offset, std::string& out, size_t& raw_begin, size_t& raw_end) {
+        XmlReader reader(xml.data() + offset, xml.size() - offset);
+        auto& tag = reader.tag;
+        int runs = 0;
+        reader.next_tag();
+        if (tag.self_closing) return runs;
+        while (reader.next_tag()) {
+            if (tag.closing) {
+                if (tag.name == "si") return runs;
+                continue;
+            }
+            if (tag.self_closing) continue;
+            if (tag.name == "t") {
+                ++runs;
+                raw_begin = offset + reader.pos;
+                reader.read_text(out);
+                raw_end = offset + reader.pos;
+            } else if (tag.name == "rPh") {
+                reader.skip_element("rPh");
+            }
+        }
+        throw Exception("sharedStrings: unexpected eof in si. offset=", offset);
+    }
+};
+
+}  // namespace xlsx
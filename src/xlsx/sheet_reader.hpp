@@ -0,0 +1,364 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <istream>
+#include <functional>
+
+#include "xlsx/exception.hpp"
+#include "xlsx/xml_reader.hpp"
+#include "xlsx/cell_ref.hpp"
+
+namespace xlsx {
+
+struct RawCell {
+    int col = -1;  // 0-index. from the r attribute, or next to the previous cell without it.
+    std::string t;
+    int s = 0;
+    std::string v;
+
+    inline
+    void clear() {
+        col = -1;
+        t.clear();
+        s = 0;
+        v.clear();
+    }
+};
+
+struct RawRow {
+    int index = -1;  // 0-index. from the r attribute, or next to the previous row without it.
+    std::vector<RawCell> cells;
+    size_t ncells = 0;
+
+    inline void clear() { index = -1; ncells = 0; }
+    inline size_t size() const { return ncells; }
+    inline RawCell& operator[](size_t i) { return cells[i]; }
+
+    // drops the last cell pushed.
+    inline void pop() { --ncells; }
+
+    inline
+    RawCell& push() {
+        // reuse the buffers of previous rows.
+        if (ncells == cells.size()) cells.emplace_back();
+        auto& cell = cells[ncells++];
+        cell.clear();
+        return cell;
+    }
+};
+
+// columns to be decoded. empty means all.
+struct ColumnProjection {
+    std::vector<bool> columns;
+
+    inline
+    bool all() const {
+        return columns.empty();
+    }
+
+    inline
+    bool contains(int colx) const {
+        if (all()) return true;
+        return 0 <= colx && static_cast<size_t>(colx) < columns.size() && columns[colx];
+    }
+
+    // -1 in colxs is ignored.
+    inline
+    void set(const std::vector<int>& colxs) {
+        columns.clear();
+        for (int colx : colxs) {
+            if (colx < 0) continue;
+            if (columns.size() <= static_cast<size_t>(colx)) columns.resize(colx + 1, false);
+            columns[colx] = true;
+        }
+        // nothing is mapped. keep one dummy column so that it does not mean all.
+        if (columns.empty()) columns.push_back(false);
+    }
+};
+
+// attributes of a <c>. r and t are views of the buffer until the next read.
+struct CellAttrs {
+    const char* r = nullptr;
+    size_t r_size = 0;
+    const char* t = nullptr;
+    size_t t_size = 0;
+    int s = 0;
+    bool self_closing = false;
+    bool prefixed = false;
+};
+
+// pull-style reader for worksheet xml.
+// reads <row>/<c>/<v> directly from the input source chunk by chunk,
+// so memory is bounded by the width of a row, not by the size of the sheet.
+struct SheetReader : XmlReader {
+    bool done = false;
+    std::string dimension;
+    // cells out of projection are skipped without reading the value. owned by caller.
+    const ColumnProjection* projection = nullptr;
+    // rows and cells out of bounds are skipped, and rows past them are not read. owned by caller.
+    const CellRange* bounds = nullptr;
+    int last_index = -1;
+    // some row had no r attribute, so its index depends on the rows read before.
+    bool implicit_rows = false;
+
+    inline
+    explicit SheetReader(std::istream& stream)
+        : SheetReader([&stream](char* dst, size_t n) -> size_t {
+              stream.read(dst, n);
+              return static_cast<size_t>(stream.gcount());
+          }) {}
+
+    inline
+    explicit SheetReader(Source source_) : XmlReader(source_) {
+        read_head();
+    }
+
+    // reads from memory without copying.
+    // with head=false, data is a part of sheetData which starts at a <row>.
+    inline
+    SheetReader(const char* data_, size_t size_, bool head = true) : XmlReader(data_, size_) {
+        if (head) read_head();
+    }
+
+    inline
+    void read_head() {
+        // read until <sheetData>.
+        while (next_tag()) {
+            if (tag.closing) continue;
+            if (tag.name == "dimension") {
+                auto ref = tag.attr("ref");
+                if (ref != nullptr) dimension = *ref;
+            } else if (tag.name == "sheetData") {
+                done = tag.self_closing;
+                return;
+            }
+        }
+        done = true;
+    }
+
+    inline
+    bool next_row(RawRow& row) {
+        while (true) {
+            if (!next_row_tag(row)) return false;
+            if (bounds == nullptr || bounds->contains_row(row.index)) break;
+            // rows are in order. the rest is out of bounds too.
+            if (bounds->last_row < row.index) {
+                done = true;
+                return false;
+            }
+            if (!tag.self_closing) skip_row(tag.prefixed);
+        }
+        if (tag.self_closing) return true;
+        bool row_prefixed = tag.prefixed;
+
+        int colx = -1;
+        CellAttrs attrs;
+        while (true) {
+            if (!read_cell_attrs(attrs)) {
+                if (!next_tag()) break;
+                if (tag.name == "row" && tag.closing) return true;
+                if (tag.name != "c" || tag.closing) continue;
+                tag_cell_attrs(attrs);
+            }
+            if (attrs.r == nullptr) {
+                ++colx;
+            } else {
+                int rowx;
+                if (!CellRef::parse(attrs.r, attrs.r + attrs.r_size, rowx, colx)) {
+                    throw Exception("bad cell reference. r=", std::string(attrs.r, attrs.r_size));
+                }
+                if (rowx != row.index) {
+                    throw Exception("bad. r=", std::string(attrs.r, attrs.r_size),
+                                    " row=", row.index, " parsed_row=", rowx);
+                }
+            }
+            if (bounds != nullptr && !bounds->contains_col(colx)) {
+                if (!attrs.self_closing) skip_cell(attrs.prefixed);
+                // cells are in order. the rest of the row is out of bounds too.
+                if (bounds->last_col < colx) {
+                    skip_row(row_prefixed);
+                    return true;
+                }
+                continue;
+            }
+            if (projection != nullptr && !projection->contains(colx)) {
+                if (!attrs.self_closing) skip_cell(attrs.prefixed);
+                continue;
+            }
+            // a cell without a value reads as no cell, e.g. of a format down to row 65536.
+            // a row of those only has no cell, and is an empty line without decoding.
+            if (attrs.self_closing) continue;
+            auto& cell = row.push();
+            cell.col = colx;
+            cell.s = attrs.s;
+            if (attrs.t != nullptr) cell.t.assign(attrs.t, attrs.t_size);
+            read_cell(cell);
+            if (cell.v.empty()) row.pop();
+        }
+        throw Exception("unexpected eof in row=", row.index + 1);
+    }
+
+    // up to the next <row>, whose index is set to row. false at the end of sheetData.
+    inline
+    bool next_row_tag(RawRow& row) {
+        row.clear();
+        if (done) return false;
+        while (true) {
+            if (!next_tag()) {
+                done = true;
+                return false;
+            }
+            if (tag.name == "row" && !tag.closing) break;
+            if (tag.name == "sheetData" && tag.closing) {
+                done = true;
+                return false;
+            }
+        }
+        auto r = tag.attr("r");
+        if (r == nullptr) {
+            row.index = last_index + 1;
+            implicit_rows = true;
+        } else {
+            int n;
+            if (!CellRef::parse_row(r->data(), r->data() + r->size(), n)) {
+                throw Exception("bad row number. r=", *r);
+            }
+            row.index = n - 1;
+        }
+        last_index = row.index;
+        return true;
+    }
+
+    // the rest of a row, after its <row> or one of its cells.
+    inline
+    void skip_row(bool prefixed) {
+        if (prefixed) {
+            skip_element("row");
+        } else {
+            // <row> has no nested <row>.
+            skip_until("</row>");
+        }
+    }
+
+    // <c> of the usual form, read from the buffer without the generic tag.
+    // false, with nothing consumed, if the next tag is not an unprefixed <c> or has an entity.
+    inline
+    bool read_cell_attrs(CellAttrs& attrs) {
+        if (!skip_text() || !ensure(3)) return false;
+        char c = data[pos + 2];
+        if (data[pos + 1] != 'c' || !(isspace(c) || c == '>' || c == '/')) return false;
+        auto end = find_tag_end();
+        const char* p = data + pos + 2;
+        const char* e = data + end;
+        attrs = CellAttrs();
+        if (e[-1] == '/') {
+            attrs.self_closing = true;
+            --e;
+        }
+        while (p < e) {
+            while (p < e && isspace(*p)) ++p;
+            if (p >= e) break;
+            auto key = p;
+            while (p < e && *p != '=' && !isspace(*p)) ++p;
+            auto key_size = p - key;
+            while (p < e && *p != '"' && *p != '\'') ++p;
+            if (p >= e) break;
+            char quote = *p++;
+            auto value = p;
+            auto q = static_cast<const char*>(std::memchr(p, quote, e - p));
+            p = q == nullptr ? e : q;
+            if (std::memchr(value, '&', p - value) != nullptr) return false;
+            if (key_size == 1) {
+                if (*key == 'r') {
+                    attrs.r = value;
+                    attrs.r_size = p - value;
+                } else if (*key == 't') {
+                    attrs.t = value;
+                    attrs.t_size = p - value;
+                } else if (*key == 's') {
+                    attrs.s = parse_int(value, p);
+                }
+            }
+            ++p;
+        }
+        pos = end + 1;
+        return true;
+    }
+
+    // from the generic tag.
+    inline
+    void tag_cell_attrs(CellAttrs& attrs) {
+        attrs = CellAttrs();
+        attrs.self_closing = tag.self_closing;
+        attrs.prefixed = tag.prefixed;
+        for (size_t i = 0; i < tag.nattrs; ++i) {
+            auto& attr = tag.attrs[i];
+            if (attr.first == "r") {
+                attrs.r = attr.second.data();
+                attrs.r_size = attr.second.size();
+            } else if (attr.first == "t") {
+                attrs.t = attr.second.data();
+                attrs.t_size = attr.second.size();
+            } else if (attr.first == "s") {
+                attrs.s = std::atoi(attr.second.c_str());
+            }
+        }
+    }
+
+    // as std::atoi reads a style index.
+    static inline
+    int parse_int(const char* p, const char* e) {
+        while (p < e && isspace(*p)) ++p;
+        bool negative = p < e && *p == '-';
+        if (p < e && (*p == '-' || *p == '+')) ++p;
+        int n = 0;
+        for (; p < e && '0' <= *p && *p <= '9'; ++p) n = n * 10 + (*p - '0');
+        return negative ? -n : n;
+    }
+
+    inline
+    void skip_cell(bool prefixed) {
+        if (prefixed) {
+            skip_element("c");
+        } else {
+            // <c> has no nested <c>.
+            skip_until("</c>");
+        }
+    }
+
+    inline
+    void read_cell(RawCell& cell) {
+        // <v>..</v></c>, the usual form.
+        if (ensure(3) && startswith("<v>", 3)) {
+            pos += 3;
+            read_text(cell.v);
+            if (ensure(8) && startswith("</v></c>", 8)) {
+                pos += 8;
+                return;
+            }
+        }
+        while (next_tag()) {
+            if (tag.closing) {
+                if (tag.name == "c") return;
+                continue;
+            }
+            if (tag.self_closing) continue;
+            if (tag.name == "v" || tag.name == "t") {
+                // <v>, or <is><t> / <is><r><t> of inline string.
+                read_text(cell.v);
+            } else if (tag.name == "rPh") {
+                // phonetic run is not a part of value.
+                skip_element("rPh");
+            }
+        }
+        throw Exception("unexpected eof in cell. col=", cell.col + 1);
+    }
+};
+
+}  // namespace xlsx
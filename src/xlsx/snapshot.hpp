@@ -0,0 +1,208 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <functional>
+#include <memory>
+#include <exception>
+
+#include "xlsx/column_store.hpp"
+#include "xlsx/zip_reader.hpp"
+
+namespace xlsx {
+
+// decoded columns of a sheet, stored in a file to be mapped by a later run.
+// the columns read from it refer to the mapping, which is not copied, and only the pages of
+// the columns in use are read from the disk.
+// bump magic when the layout or the meaning of the columns changes.
+// the key is opaque bytes which must match exactly, e.g. path, size, mtime and entry crcs.
+// layout, all in native byte order and padded to 8 bytes:
+//   magic[8] key_size key[] nrows ncols ncolumns
+//   for each column: last_row nbits ntags ntext bits[] values[] tags[] text[]
+struct Snapshot {
+    static inline
+    const char* magic() {
+        return "XCSNAP01";
+    }
+
+    struct Writer {
+        std::ofstream out;
+
+        inline
+        void u64(uint64_t v) {
+            out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+
+        inline
+        void bytes(const void* p, size_t n) {
+            static const char zeros[8] = {};
+            out.write(static_cast<const char*>(p), n);
+            out.write(zeros, (8 - n % 8) % 8);
+        }
+    };
+
+    // a view of the mapping, checked against its end.
+    struct Reader {
+        const char* p;
+        const char* end;
+
+        inline
+        bool u64(uint64_t& v) {
+            if (end - p < 8) return false;
+            std::memcpy(&v, p, sizeof(v));
+            p += 8;
+            return true;
+        }
+
+        inline
+        const char* bytes(size_t n) {
+            size_t padded = n + (8 - n % 8) % 8;
+            if (padded < n || static_cast<size_t>(end - p) < padded) return nullptr;
+            auto q = p;
+            p += padded;
+            return q;
+        }
+    };
+
+    // name of the snapshot file of a sheet of a workbook, or of another record of it.
+    static inline
+    std::string filename(const std::string& dir, const std::string& path,
+                         const std::string& sheet, const char* ext = ".snapshot") {
+        // fnv-1a
+        uint64_t h = 14695981039346656037ull;
+        for (char c : path + '\0' + sheet) {
+            h = (h ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+        }
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(h));
+        return dir + "/" + hex + ext;
+    }
+
+    // written to a temporary file and renamed, so a reader never sees a partial one.
+    // false if it could not be written. a snapshot is only a cache.
+    static inline
+    bool write(const std::string& file, const std::string& key, int nrows, int ncols,
+               const std::vector<ColumnStore>& columns) {
+        auto tmp = file + "." +
+                   std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) +
+                   ".tmp";
+        {
+            Writer w;
+            w.out.open(tmp.c_str(), std::ios::binary | std::ios::trunc);
+            if (!w.out) return false;
+            w.out.write(magic(), 8);
+            w.u64(key.size());
+            w.bytes(key.data(), key.size());
+            w.u64(nrows);
+            w.u64(ncols);
+            w.u64(columns.size());
+            for (auto& column : columns) {
+                std::vector<uint8_t> tags(column.size());
+                std::vector<uint64_t> values(column.size());
+                for (size_t i = 0; i < column.size(); ++i) {
+                    tags[i] = column.tag_at(i);
+                    values[i] = column.value_at(i);
+                }
+                w.u64(static_cast<int64_t>(column.last_row));
+                w.u64(column.nbits());
+                w.u64(column.size());
+                w.u64(column.text_size());
+                w.bytes(column.bits_data(), column.nbits() * sizeof(uint64_t));
+                w.bytes(values.data(), values.size() * sizeof(uint64_t));
+                w.bytes(tags.data(), tags.size());
+                w.bytes(column.text_data(), column.text_size());
+            }
+            w.out.flush();
+            if (!w.out) {
+                w.out.close();
+                std::remove(tmp.c_str());
+                return false;
+            }
+        }
+        if (std::rename(tmp.c_str(), file.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // false if there is no snapshot, or it is of another key or broken.
+    static inline
+    bool read(const std::string& file, const std::string& key, int& nrows, int& ncols,
+              std::vector<ColumnStore>& columns) {
+        struct stat statbuf;
+        if (::stat(file.c_str(), &statbuf) != 0 || statbuf.st_size == 0) return false;
+        std::shared_ptr<MappedFile> map;
+        try {
+            map = std::make_shared<MappedFile>(file);
+        } catch (std::exception&) {
+            return false;
+        }
+        Reader r{map->data, map->data + map->size};
+        uint64_t key_size, rows, cols, ncolumns;
+        auto head = r.bytes(8);
+        if (head == nullptr || std::memcmp(head, magic(), 8) != 0) return false;
+        if (!r.u64(key_size) || key_size != key.size()) return false;
+        auto key_data = r.bytes(key_size);
+        if (key_data == nullptr || std::memcmp(key_data, key.data(), key_size) != 0) return false;
+        if (!r.u64(rows) || !r.u64(cols) || !r.u64(ncolumns) || ncolumns > cols) return false;
+
+        std::vector<ColumnStore> stores(ncolumns);
+        for (auto& column : stores) {
+            uint64_t last_row, nbits, ntags, ntext;
+            if (!r.u64(last_row) || !r.u64(nbits) || !r.u64(ntags) || !r.u64(ntext)) return false;
+            if (nbits > (rows + 63) / 64 || ntags > rows) return false;
+            auto row = static_cast<int64_t>(last_row);
+            if (row < -1 || row >= static_cast<int64_t>(rows)) return false;
+            auto bits = r.bytes(nbits * sizeof(uint64_t));
+            auto values = r.bytes(ntags * sizeof(uint64_t));
+            auto tags = r.bytes(ntags);
+            auto text = r.bytes(ntext);
+            if (bits == nullptr || values == nullptr || tags == nullptr || text == nullptr) {
+                return false;
+            }
+            // every array is at a multiple of 8 bytes from the page aligned mapping.
+            // every cell refers to its own column text, as text_at() and number_at() read it.
+            for (uint64_t i = 0; i < ntags; ++i) {
+                uint8_t tag = reinterpret_cast<const uint8_t*>(tags)[i];
+                uint64_t v;
+                std::memcpy(&v, values + i * sizeof(v), sizeof(v));
+                if ((tag & ColumnStore::kTextTag) && (v >> 32) + (v & 0xFFFFFFFF) > ntext) {
+                    return false;
+                }
+                if ((tag & ColumnStore::kNumberTag) &&
+                    (!(tag & ColumnStore::kTextTag) || (v >> 32) < sizeof(uint64_t))) {
+                    return false;
+                }
+            }
+            column.last_row = static_cast<int>(row);
+            column.mapping = map;
+            column.mapped.bits = reinterpret_cast<const uint64_t*>(bits);
+            column.mapped.nbits = nbits;
+            column.mapped.values = reinterpret_cast<const uint64_t*>(values);
+            column.mapped.tags = reinterpret_cast<const uint8_t*>(tags);
+            column.mapped.ncells = ntags;
+            column.mapped.text = text;
+            column.mapped.ntext = ntext;
+            column.finish();
+            uint64_t ncells = 0;
+            if (nbits > 0) {
+                ncells = column.ranks.back() + ColumnStore::popcount(column.mapped.bits[nbits - 1]);
+            }
+            if (ncells != ntags) return false;
+        }
+        nrows = static_cast<int>(rows);
+        ncols = static_cast<int>(cols);
+        columns = std::move(stores);
+        return true;
+    }
+};
+
+}  // namespace xlsx
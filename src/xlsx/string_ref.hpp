@@ -0,0 +1,45 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <cstring>
+#include <string>
+#include <ostream>
+
+namespace xlsx {
+
+// non-owning view of characters. (std::string_view is not available in c++11)
+struct StringRef {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    inline StringRef() {}
+    inline StringRef(const char* data_, size_t size_) : data(data_), size(size_) {}
+    inline StringRef(const std::string& s) : data(s.data()), size(s.size()) {}  // NOLINT
+
+    inline bool empty() const { return size == 0; }
+    inline const char* begin() const { return data; }
+    inline const char* end() const { return data + size; }
+    inline std::string str() const { return std::string(data, size); }
+
+    inline
+    bool operator==(const StringRef& o) const {
+        return size == o.size && (size == 0 || std::memcmp(data, o.data, size) == 0);
+    }
+    inline bool operator!=(const StringRef& o) const { return !(*this == o); }
+
+    // as std::string::compare.
+    inline
+    int compare(const StringRef& o) const {
+        size_t n = size < o.size ? size : o.size;
+        int c = n == 0 ? 0 : std::memcmp(data, o.data, n);
+        if (c != 0) return c;
+        return size < o.size ? -1 : (size > o.size ? 1 : 0);
+    }
+};
+
+inline
+std::ostream& operator<<(std::ostream& os, const StringRef& s) {
+    return os.write(s.data, s.size);
+}
+
+}  // namespace xlsx
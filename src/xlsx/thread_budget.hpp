@@ -0,0 +1,61 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <algorithm>
+#include <mutex>
+
+namespace xlsx {
+
+// threads which parallel decoders may add to their own, shared by the whole process.
+// --jobs workbooks already run side by side, each on a thread of its own. a decoder takes
+// only the threads of jobs which are done, so the process runs at most --jobs threads.
+// not limited until limit() is called, e.g. a single workbook of a library user.
+struct ThreadBudget {
+    std::mutex mutex;
+    int idle = -1;  // -1: not limited.
+
+    // up to n threads, or none.
+    struct Lease {
+        ThreadBudget& budget;
+        int n;
+
+        inline
+        Lease(ThreadBudget& budget_, int n_) : budget(budget_), n(budget_.acquire(n_)) {}
+        inline
+        ~Lease() { budget.release(n); }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+    };
+
+    static inline
+    ThreadBudget& global() {
+        static ThreadBudget budget;
+        return budget;
+    }
+
+    // n threads are idle now. the others are given back by release().
+    inline
+    void limit(int n) {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle = n;
+    }
+
+    inline
+    int acquire(int n) {
+        if (n <= 0) return 0;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idle < 0) return n;
+        n = std::min(n, idle);
+        idle -= n;
+        return n;
+    }
+
+    inline
+    void release(int n) {
+        if (n <= 0) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idle >= 0) idle += n;
+    }
+};
+
+}  // namespace xlsx
@@ -0,0 +1,378 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "xlsx/exception.hpp"
+#include "xlsx/xml_reader.hpp"
+#include "xlsx/sheet_reader.hpp"
+#include "xlsx/cell_ref.hpp"
+
+namespace xlsx {
+
+// record stream of a part of a binary workbook (.xlsb). SEE: [MS-XLSB] 2.1.4
+// each record is a 7bit-encoded type and size, followed by its body.
+struct RecordReader {
+    // record types in use.
+    enum : uint32_t {
+        kRowHdr = 0,
+        kCellBlank = 1,
+        kCellRk = 2,
+        kCellError = 3,
+        kCellBool = 4,
+        kCellReal = 5,
+        kCellSt = 6,
+        kCellIsst = 7,
+        kFmlaString = 8,
+        kFmlaNum = 9,
+        kFmlaBool = 10,
+        kFmlaError = 11,
+        kSSTItem = 19,
+        kCellRString = 62,
+        kFmt = 44,
+        kXF = 47,
+        kBeginSheetData = 145,
+        kEndSheetData = 146,
+        kWsDim = 148,
+        kBundleSh = 156,
+        kBeginCellXFs = 617,
+        kEndCellXFs = 618,
+    };
+
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+    // current record.
+    uint32_t type = 0;
+    const char* body = nullptr;
+    uint32_t length = 0;
+
+    inline
+    RecordReader(const char* data_, size_t size_) : data(data_), size(size_) {}
+
+    inline
+    bool next() {
+        if (pos >= size) return false;
+        uint32_t t, n;
+        if (!read_varint(2, t) || !read_varint(4, n)) {
+            throw Exception("xlsb: broken record header. pos=", pos);
+        }
+        if (n > size - pos) {
+            throw Exception("xlsb: broken record. type=", t, " size=", n);
+        }
+        type = t;
+        length = n;
+        body = data + pos;
+        pos += n;
+        return true;
+    }
+
+    inline
+    bool read_varint(int max_bytes, uint32_t& out) {
+        out = 0;
+        for (int i = 0; i < max_bytes; ++i) {
+            if (pos >= size) return false;
+            uint8_t b = static_cast<uint8_t>(data[pos++]);
+            out |= static_cast<uint32_t>(b & 0x7F) << (7 * i);
+            if ((b & 0x80) == 0) return true;
+        }
+        return true;
+    }
+
+    // little endian field of the current record. 0 if the record is short.
+    inline
+    uint32_t u32(uint32_t offset) const {
+        if (offset + 4 > length) return 0;
+        auto u = reinterpret_cast<const uint8_t*>(body + offset);
+        return u[0] | (u[1] << 8) | (u[2] << 16) | (static_cast<uint32_t>(u[3]) << 24);
+    }
+
+    inline
+    uint32_t u16(uint32_t offset) const {
+        if (offset + 2 > length) return 0;
+        auto u = reinterpret_cast<const uint8_t*>(body + offset);
+        return u[0] | (u[1] << 8);
+    }
+
+    inline
+    uint32_t u8(uint32_t offset) const {
+        if (offset + 1 > length) return 0;
+        return static_cast<uint8_t>(body[offset]);
+    }
+
+    inline
+    double f64(uint32_t offset) const {
+        double d = 0.0;
+        if (offset + 8 <= length) std::memcpy(&d, body + offset, sizeof(d));
+        return d;
+    }
+
+    // XLWideString at offset, as utf-8. returns the offset after it.
+    inline
+    uint32_t wide_string(uint32_t offset, std::string& out) const {
+        out.clear();
+        uint32_t cch = u32(offset);
+        offset += 4;
+        // XLNullableWideString is null with 0xFFFFFFFF.
+        if (cch == 0xFFFFFFFF) return offset;
+        if (offset + uint64_t(cch) * 2 > length) {
+            throw Exception("xlsb: broken string. type=", type);
+        }
+        for (uint32_t i = 0; i < cch; ++i) {
+            uint32_t c = u16(offset + i * 2);
+            if (0xD800 <= c && c < 0xDC00 && i + 1 < cch) {
+                uint32_t low = u16(offset + (i + 1) * 2);
+                if (0xDC00 <= low && low < 0xE000) {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    ++i;
+                }
+            }
+            XmlReader::append_utf8(c, out);
+        }
+        return offset + cch * 2;
+    }
+
+    // RkNumber. SEE: [MS-XLSB] 2.5.122
+    static inline
+    double rk_number(uint32_t rk) {
+        double d;
+        if (rk & 0x02) {
+            d = static_cast<double>(static_cast<int32_t>(rk) >> 2);
+        } else {
+            uint64_t bits = static_cast<uint64_t>(rk & 0xFFFFFFFC) << 32;
+            std::memcpy(&d, &bits, sizeof(d));
+        }
+        return (rk & 0x01) ? d / 100 : d;
+    }
+
+    // shortest text which reads back the same double, as excel writes <v> of xlsx.
+    static inline
+    void format_number(double d, std::string& out) {
+        char buf[32];
+        for (int precision = 15; precision <= 17; ++precision) {
+            std::snprintf(buf, sizeof(buf), "%.*g", precision, d);
+            if (std::strtod(buf, nullptr) == d) break;
+        }
+        // 1e-05 -> 1E-5
+        out.clear();
+        for (const char* p = buf; *p != '\0'; ++p) {
+            if (*p != 'e') {
+                out.push_back(*p);
+                continue;
+            }
+            out.push_back('E');
+            if (p[1] == '+' || p[1] == '-') out.push_back(*++p);
+            while (p[1] == '0' && p[2] != '\0') ++p;
+        }
+    }
+
+    static inline
+    const char* error_text(uint32_t code) {
+        switch (code) {
+            case 0x00: return "#NULL!";
+            case 0x07: return "#DIV/0!";
+            case 0x0F: return "#VALUE!";
+            case 0x17: return "#REF!";
+            case 0x1D: return "#NAME?";
+            case 0x24: return "#NUM!";
+            case 0x2A: return "#N/A";
+            case 0x2B: return "#GETTING_DATA";
+        }
+        return "#ERROR!";
+    }
+};
+
+// sheets of xl/workbook.bin, in order.
+struct XlsbWorkbook {
+    std::vector<std::pair<std::string, std::string>> sheets;  // (r:id, name)
+
+    inline
+    XlsbWorkbook(const char* data, size_t size) {
+        RecordReader reader(data, size);
+        std::string rid, name;
+        while (reader.next()) {
+            if (reader.type != RecordReader::kBundleSh) continue;
+            // hsState, iTabID, strRelID, strName
+            auto offset = reader.wide_string(8, rid);
+            reader.wide_string(offset, name);
+            sheets.emplace_back(rid, name);
+        }
+    }
+};
+
+// xl/sharedStrings.bin. runs and phonetic parts are dropped, as the xml one does.
+struct XlsbSharedStrings {
+    std::vector<std::string> strings;
+
+    inline
+    XlsbSharedStrings(const char* data, size_t size) {
+        RecordReader reader(data, size);
+        while (reader.next()) {
+            if (reader.type != RecordReader::kSSTItem) continue;
+            // RichStr: flags, then the string.
+            strings.emplace_back();
+            reader.wide_string(1, strings.back());
+        }
+    }
+};
+
+// number formats of xl/styles.bin, which tell the date cells.
+struct XlsbStyles {
+    std::unordered_map<int, std::string> format_codes;
+    std::vector<int> num_fmts_by_xf_index;
+
+    inline
+    XlsbStyles(const char* data, size_t size) {
+        RecordReader reader(data, size);
+        bool cell_xfs = false;
+        std::string code;
+        while (reader.next()) {
+            switch (reader.type) {
+                case RecordReader::kFmt: {
+                    reader.wide_string(2, code);
+                    format_codes[reader.u16(0)] = code;
+                    break;
+                }
+                case RecordReader::kBeginCellXFs: cell_xfs = true; break;
+                case RecordReader::kEndCellXFs: cell_xfs = false; break;
+                case RecordReader::kXF: {
+                    // ixfeParent, iFmt. the xfs of cell styles are not referred by cells.
+                    if (cell_xfs) num_fmts_by_xf_index.push_back(reader.u16(2));
+                    break;
+                }
+            }
+        }
+    }
+};
+
+// worksheet records, read into the same rows as SheetReader does.
+// values are given as the text of <v> in xlsx, so that cells decode the same.
+struct XlsbSheetReader : RecordReader {
+    bool done = false;
+    std::string dimension;
+    const ColumnProjection* projection = nullptr;
+    const CellRange* bounds = nullptr;
+    int pending_row = -1;  // row header read ahead of the cells of the previous row.
+
+    inline
+    XlsbSheetReader(const char* data_, size_t size_) : RecordReader(data_, size_) {
+        read_head();
+    }
+
+    inline
+    void read_head() {
+        while (next()) {
+            if (type == kWsDim) {
+                // rwFirst, rwLast, colFirst, colLast
+                dimension = CellRef::name(u32(0), u32(8)) + ":" + CellRef::name(u32(4), u32(12));
+            } else if (type == kBeginSheetData) {
+                return;
+            }
+        }
+        done = true;
+    }
+
+    inline
+    bool next_row(RawRow& row) {
+        row.clear();
+        if (done) return false;
+        while (true) {
+            while (pending_row < 0) {
+                if (!next() || type == kEndSheetData) {
+                    done = true;
+                    return false;
+                }
+                if (type == kRowHdr) pending_row = static_cast<int>(u32(0));
+            }
+            if (bounds == nullptr || bounds->contains_row(pending_row)) break;
+            if (bounds->last_row < pending_row) {
+                done = true;
+                return false;
+            }
+            // the cells of a row out of bounds, up to the next row header.
+            pending_row = -1;
+        }
+        row.index = pending_row;
+        pending_row = -1;
+        while (next()) {
+            if (type == kRowHdr) {
+                pending_row = static_cast<int>(u32(0));
+                return true;
+            }
+            if (type == kEndSheetData) {
+                done = true;
+                return true;
+            }
+            // a cell without a value reads as no cell, as SheetReader does.
+            if (!is_cell(type) || type == kCellBlank) continue;
+            int colx = static_cast<int>(u32(0));
+            if (bounds != nullptr && !bounds->contains_col(colx)) continue;
+            if (projection != nullptr && !projection->contains(colx)) continue;
+            auto& cell = row.push();
+            cell.col = colx;
+            cell.s = static_cast<int>(u32(4) & 0xFFFFFF);
+            read_cell(cell);
+            if (cell.v.empty()) row.pop();
+        }
+        done = true;
+        return true;
+    }
+
+    // BrtCell* and BrtFmla* records, which begin with column and style.
+    static inline
+    bool is_cell(uint32_t t) {
+        return t <= kFmlaError || t == kCellRString;
+    }
+
+    // value after the 8 bytes of column and style.
+    inline
+    void read_cell(RawCell& cell) {
+        switch (type) {
+            case kCellBlank: break;
+            case kCellRk: format_number(rk_number(u32(8)), cell.v); break;
+            case kCellReal:
+            case kFmlaNum: format_number(f64(8), cell.v); break;
+            case kCellBool:
+            case kFmlaBool: {
+                cell.t = "b";
+                cell.v = u8(8) ? "1" : "0";
+                break;
+            }
+            case kCellError:
+            case kFmlaError: {
+                cell.t = "e";
+                cell.v = error_text(u8(8));
+                break;
+            }
+            case kCellSt: {
+                cell.t = "inlineStr";
+                wide_string(8, cell.v);
+                break;
+            }
+            case kCellRString: {
+                // RichStr: flags, then the string. runs are dropped, as of shared strings.
+                cell.t = "inlineStr";
+                wide_string(9, cell.v);
+                break;
+            }
+            case kFmlaString: {
+                cell.t = "str";
+                wide_string(8, cell.v);
+                break;
+            }
+            case kCellIsst: {
+                cell.t = "s";
+                cell.v = std::to_string(u32(8));
+                break;
+            }
+        }
+    }
+};
+
+}  // namespace xlsx
@@ -0,0 +1,366 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+
+#include "xlsx/exception.hpp"
+#include "xlsx/scan.hpp"
+
+namespace xlsx {
+
+// minimal pull tokenizer for the xml parts of a workbook.
+// yields tags one by one and reads text on demand, chunk by chunk from a source or from memory.
+struct XmlReader {
+    struct Tag {
+        std::string name;  // without namespace prefix.
+        bool closing = false;
+        bool self_closing = false;
+        bool prefixed = false;  // had a namespace prefix.
+        std::vector<std::pair<std::string, std::string>> attrs;
+        size_t nattrs = 0;
+
+        inline
+        const std::string* attr(const char* key) const {
+            for (size_t i = 0; i < nattrs; ++i) {
+                if (attrs[i].first == key) return &attrs[i].second;
+            }
+            return nullptr;
+        }
+    };
+
+    // reads at most n bytes into dst, returns 0 at the end.
+    using Source = std::function<size_t(char*, size_t)>;
+    static const size_t kChunkSize = 64 * 1024;
+
+    Source source;
+    std::string buf;
+    const char* data = nullptr;  // buf.data(), or memory given by caller.
+    size_t size = 0;
+    size_t pos = 0;
+    bool eof = false;
+    Tag tag;
+
+    inline
+    explicit XmlReader(Source source_) : source(source_) {
+        buf.reserve(kChunkSize * 2);
+    }
+
+    // reads from memory without copying.
+    inline
+    XmlReader(const char* data_, size_t size_) : data(data_), size(size_), eof(true) {}
+
+    // whole input is in memory.
+    inline
+    bool in_memory() const {
+        return !source;
+    }
+
+    inline
+    void skip_element(const char* name) {
+        while (next_tag()) {
+            if (tag.closing && tag.name == name) return;
+        }
+        throw Exception("unexpected eof in ", name);
+    }
+
+    inline
+    bool fill() {
+        if (eof) return false;
+        if (pos > 0) {
+            buf.erase(0, pos);
+            pos = 0;
+        }
+        auto len = buf.size();
+        buf.resize(len + kChunkSize);
+        auto n = source(&buf[len], kChunkSize);
+        buf.resize(len + n);
+        data = buf.data();
+        size = buf.size();
+        if (n == 0) eof = true;
+        return n > 0;
+    }
+
+    inline
+    bool ensure(size_t n) {
+        while (size < pos + n) {
+            if (!fill()) return false;
+        }
+        return true;
+    }
+
+    inline
+    bool startswith(const char* s, size_t n) {
+        return pos + n <= size && std::memcmp(data + pos, s, n) == 0;
+    }
+
+    // returns position of term from pos in current buffer, or npos.
+    inline
+    size_t find(const char* term, size_t n) {
+        size_t p = pos;
+        while (p + n <= size) {
+            auto q = static_cast<const char*>(std::memchr(data + p, term[0], size - p));
+            if (q == nullptr) break;
+            p = q - data;
+            if (p + n > size) break;
+            if (std::memcmp(data + p, term, n) == 0) return p;
+            ++p;
+        }
+        return std::string::npos;
+    }
+
+    inline
+    bool skip_text() {
+        // markup is mostly a tag right after another.
+        if (pos < size && data[pos] == '<') return true;
+        while (true) {
+            if (pos < size) {
+                auto p = static_cast<const char*>(std::memchr(data + pos, '<', size - pos));
+                if (p != nullptr) {
+                    pos = p - data;
+                    return true;
+                }
+            }
+            pos = size;
+            if (!fill()) return false;
+        }
+    }
+
+    inline
+    void skip_until(const char* term) {
+        size_t n = std::strlen(term);
+        while (true) {
+            auto p = find(term, n);
+            if (p != std::string::npos) {
+                pos = p + n;
+                return;
+            }
+            if (size > pos + n) pos = size - n;
+            if (!fill()) throw Exception("unexpected eof. expect ", term);
+        }
+    }
+
+    inline
+    bool next_tag() {
+        while (true) {
+            if (!skip_text()) return false;
+            if (!ensure(2)) throw Exception("unexpected eof in tag");
+            char c = data[pos + 1];
+            if (c == '?') {
+                skip_until("?>");
+                continue;
+            }
+            if (c == '!') {
+                ensure(9);
+                if (startswith("<!--", 4)) {
+                    skip_until("-->");
+                } else if (startswith("<![CDATA[", 9)) {
+                    skip_until("]]>");
+                } else {
+                    skip_until(">");
+                }
+                continue;
+            }
+            auto end = find_tag_end();
+            parse_tag(pos, end);
+            pos = end + 1;
+            return true;
+        }
+    }
+
+    // '>' of the tag at pos. quoted values are jumped over.
+    // a tag cut at the end of the buffer is scanned again from its start after fill().
+    inline
+    size_t find_tag_end() {
+        while (true) {
+            auto e = data + size;
+            auto p = Scan::tag_end(data + pos + 1, e);
+            if (p != e) return p - data;
+            if (!fill()) throw Exception("unexpected eof in tag");
+        }
+    }
+
+    static inline
+    bool isspace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    inline
+    void parse_tag(size_t b, size_t e) {
+        // data[b] == '<', data[e] == '>'
+        size_t p = b + 1;
+        tag.closing = false;
+        tag.self_closing = false;
+        tag.nattrs = 0;
+        if (data[p] == '/') {
+            tag.closing = true;
+            ++p;
+        }
+        size_t name_begin = p;
+        if (data[e - 1] == '/') {
+            tag.self_closing = true;
+            --e;
+        }
+        size_t ns = p;
+        while (p < e && !isspace(data[p])) {
+            if (data[p] == ':') ns = p + 1;
+            ++p;
+        }
+        tag.name.assign(data + ns, p - ns);
+        tag.prefixed = ns != name_begin;
+
+        while (p < e) {
+            while (p < e && isspace(data[p])) ++p;
+            if (p >= e) break;
+            size_t kb = p;
+            while (p < e && data[p] != '=' && !isspace(data[p])) ++p;
+            size_t ke = p;
+            while (p < e && data[p] != '"' && data[p] != '\'') ++p;
+            if (p >= e) break;
+            char quote = data[p++];
+            size_t vb = p;
+            auto q = static_cast<const char*>(std::memchr(data + p, quote, e - p));
+            p = q == nullptr ? e : q - data;
+            if (tag.nattrs == tag.attrs.size()) tag.attrs.emplace_back();
+            auto& attr = tag.attrs[tag.nattrs++];
+            attr.first.assign(data + kb, ke - kb);
+            attr.second.clear();
+            unescape(data + vb, data + p, attr.second);
+            ++p;
+        }
+    }
+
+    inline
+    void read_text(std::string& out) {
+        while (true) {
+            if (pos >= size && !fill()) return;
+            const size_t n = size;
+            size_t p = Scan::find3(data + pos, data + n, '<', '&', '\r') - data;
+            out.append(data + pos, p - pos);
+            pos = p;
+            if (p == n) continue;
+            char c = data[p];
+            if (c == '<') {
+                ensure(9);
+                if (!startswith("<![CDATA[", 9)) return;
+                pos += 9;
+                read_cdata(out);
+            } else if (c == '\r') {
+                // normalize eol.
+                out.push_back('\n');
+                ++pos;
+                if (ensure(1) && data[pos] == '\n') ++pos;
+            } else {
+                // longest entity: &#x10FFFF;
+                ensure(10);
+                auto end = find(";", 1);
+                if (end == std::string::npos || end - pos > 10) {
+                    out.push_back('&');
+                    ++pos;
+                } else {
+                    pos += decode_entity(data + pos, data + end + 1, out);
+                }
+            }
+        }
+    }
+
+    inline
+    void read_cdata(std::string& out) {
+        while (true) {
+            auto p = find("]]>", 3);
+            if (p != std::string::npos) {
+                out.append(data + pos, p - pos);
+                pos = p + 3;
+                return;
+            }
+            if (size > pos + 2) {
+                out.append(data + pos, size - pos - 2);
+                pos = size - 2;
+            }
+            if (!fill()) throw Exception("unexpected eof in cdata");
+        }
+    }
+
+    static inline
+    void unescape(const char* p, const char* e, std::string& out) {
+        while (p < e) {
+            auto q = static_cast<const char*>(std::memchr(p, '&', e - p));
+            if (q == nullptr) q = e;
+            out.append(p, q);
+            if (q == e) return;
+            auto end = q;
+            while (end < e && *end != ';') ++end;
+            if (end == e) {
+                out.append(q, e);
+                return;
+            }
+            p = q + decode_entity(q, end + 1, out);
+        }
+    }
+
+    // p: "&...;", returns consumed bytes.
+    static inline
+    size_t decode_entity(const char* p, const char* e, std::string& out) {
+        size_t n = e - p;
+        auto name = p + 1;
+        auto len = n - 2;
+        if (len == 2 && std::strncmp(name, "lt", 2) == 0) {
+            out.push_back('<');
+        } else if (len == 2 && std::strncmp(name, "gt", 2) == 0) {
+            out.push_back('>');
+        } else if (len == 3 && std::strncmp(name, "amp", 3) == 0) {
+            out.push_back('&');
+        } else if (len == 4 && std::strncmp(name, "quot", 4) == 0) {
+            out.push_back('"');
+        } else if (len == 4 && std::strncmp(name, "apos", 4) == 0) {
+            out.push_back('\'');
+        } else if (len >= 2 && name[0] == '#') {
+            bool hex = name[1] == 'x';
+            uint32_t code = 0;
+            for (size_t i = hex ? 2 : 1; i < len; ++i) {
+                char c = name[i];
+                if ('0' <= c && c <= '9') {
+                    code = code * (hex ? 16 : 10) + (c - '0');
+                } else if (hex && 'a' <= c && c <= 'f') {
+                    code = code * 16 + (c - 'a' + 10);
+                } else if (hex && 'A' <= c && c <= 'F') {
+                    code = code * 16 + (c - 'A' + 10);
+                } else {
+                    out.push_back('&');
+                    return 1;
+                }
+            }
+            append_utf8(code, out);
+        } else {
+            // unknown entity is left as it is.
+            out.push_back('&');
+            return 1;
+        }
+        return n;
+    }
+
+    static inline
+    void append_utf8(uint32_t code, std::string& out) {
+        if (code < 0x80) {
+            out.push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+        }
+    }
+};
+
+}  // namespace xlsx
@@ -0,0 +1,290 @@
+// Copyright (c) 2016 peposso All Rights Reserved.
+// Released under the MIT license
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "xlsx/exception.hpp"
+#include "xlsx/string_ref.hpp"
+
+namespace xlsx {
+
+// read-only memory mapping of a whole file.
+// the file descriptor is closed right after mapping.
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    inline
+    explicit MappedFile(const std::string& path) {
+        #ifdef _WIN32
+        HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw Exception("file=", path, ": cant open.");
+        }
+        LARGE_INTEGER filesize;
+        if (!::GetFileSizeEx(file, &filesize) || filesize.QuadPart == 0) {
+            ::CloseHandle(file);
+            throw Exception("file=", path, ": cant get size.");
+        }
+        HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        ::CloseHandle(file);
+        if (mapping == nullptr) {
+            throw Exception("file=", path, ": cant map.");
+        }
+        auto p = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        ::CloseHandle(mapping);
+        if (p == nullptr) {
+            throw Exception("file=", path, ": cant map.");
+        }
+        data = static_cast<const char*>(p);
+        size = static_cast<size_t>(filesize.QuadPart);
+        #else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw Exception("file=", path, ": cant open.");
+        }
+        struct stat statbuf;
+        if (::fstat(fd, &statbuf) != 0 || statbuf.st_size == 0) {
+            ::close(fd);
+            throw Exception("file=", path, ": cant get size.");
+        }
+        size = static_cast<size_t>(statbuf.st_size);
+        auto p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            throw Exception("file=", path, ": cant map.");
+        }
+        data = static_cast<const char*>(p);
+        #endif
+    }
+
+    inline
+    ~MappedFile() {
+        if (data == nullptr) return;
+        #ifdef _WIN32
+        ::UnmapViewOfFile(data);
+        #else
+        ::munmap(const_cast<char*>(data), size);
+        #endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+// zip container over a mapped file.
+// parses the central directory in place, and exposes each entry as a span of the mapping.
+// names are views of the mapping, and looked up by a hash table without building strings.
+struct ZipReader {
+    struct Entry {
+        StringRef name;
+        uint16_t flags = 0;
+        uint16_t method = 0;
+        uint32_t crc32 = 0;
+        uint64_t compressed_size = 0;
+        uint64_t size = 0;
+        uint64_t offset = 0;  // of local file header
+    };
+
+    static const uint32_t kLocalFileHeaderSignature = 0x04034b50;
+    static const uint32_t kCentralDirectorySignature = 0x02014b50;
+    static const uint32_t kEndOfCentralDirectorySignature = 0x06054b50;
+    static const uint32_t kZip64EndOfCentralDirectorySignature = 0x06064b50;
+    static const uint32_t kZip64LocatorSignature = 0x07064b50;
+    static const uint16_t kEncryptedFlag = 0x0001;
+
+    std::string path;
+    MappedFile file;
+    std::vector<Entry> entries;
+    // open addressing by name. index + 1 of the entry, or 0 if empty.
+    std::vector<uint32_t> slots;
+
+    inline
+    explicit ZipReader(const std::string& path_) : path(path_), file(path_) {
+        read_central_directory();
+        build_index();
+    }
+
+    static inline uint16_t read16(const char* p) {
+        auto u = reinterpret_cast<const uint8_t*>(p);
+        return static_cast<uint16_t>(u[0] | (u[1] << 8));
+    }
+    static inline uint32_t read32(const char* p) {
+        return static_cast<uint32_t>(read16(p)) | (static_cast<uint32_t>(read16(p + 2)) << 16);
+    }
+    static inline uint64_t read64(const char* p) {
+        return static_cast<uint64_t>(read32(p)) | (static_cast<uint64_t>(read32(p + 4)) << 32);
+    }
+
+    inline
+    void check(uint64_t offset, uint64_t n) {
+        if (offset > file.size || n > file.size - offset) {
+            throw Exception("file=", path, ": broken zip. offset=", offset);
+        }
+    }
+
+    inline
+    void read_central_directory() {
+        // EOCD is 22 bytes, followed by a comment up to 65535 bytes.
+        if (file.size < 22) {
+            throw Exception("file=", path, ": not a zip file.");
+        }
+        size_t eocd = std::string::npos;
+        size_t lower = file.size > 22 + 0xFFFF ? file.size - 22 - 0xFFFF : 0;
+        for (size_t p = file.size - 22 + 1; p-- > lower;) {
+            if (read32(file.data + p) == kEndOfCentralDirectorySignature) {
+                eocd = p;
+                break;
+            }
+        }
+        if (eocd == std::string::npos) {
+            throw Exception("file=", path, ": end of central directory not found.");
+        }
+        const char* e = file.data + eocd;
+        uint64_t count = read16(e + 10);
+        uint64_t cd_size = read32(e + 12);
+        uint64_t cd_offset = read32(e + 16);
+
+        if (count == 0xFFFF || cd_size == 0xFFFFFFFF || cd_offset == 0xFFFFFFFF) {
+            // zip64
+            if (eocd < 20 || read32(e - 20) != kZip64LocatorSignature) {
+                throw Exception("file=", path, ": zip64 locator not found.");
+            }
+            uint64_t eocd64 = read64(e - 20 + 8);
+            check(eocd64, 56);
+            const char* e64 = file.data + eocd64;
+            if (read32(e64) != kZip64EndOfCentralDirectorySignature) {
+                throw Exception("file=", path, ": zip64 end of central directory not found.");
+            }
+            count = read64(e64 + 32);
+            cd_size = read64(e64 + 40);
+            cd_offset = read64(e64 + 48);
+        }
+        check(cd_offset, cd_size);
+
+        entries.reserve(count);
+        uint64_t p = cd_offset;
+        for (uint64_t i = 0; i < count; ++i) {
+            check(p, 46);
+            const char* h = file.data + p;
+            if (read32(h) != kCentralDirectorySignature) {
+                throw Exception("file=", path, ": broken central directory. index=", i);
+            }
+            Entry entry;
+            entry.flags = read16(h + 8);
+            entry.method = read16(h + 10);
+            entry.crc32 = read32(h + 16);
+            entry.compressed_size = read32(h + 20);
+            entry.size = read32(h + 24);
+            uint16_t name_len = read16(h + 28);
+            uint16_t extra_len = read16(h + 30);
+            uint16_t comment_len = read16(h + 32);
+            entry.offset = read32(h + 42);
+            check(p + 46, name_len + extra_len + comment_len);
+            entry.name = StringRef(h + 46, name_len);
+            read_zip64_extra(entry, h + 46 + name_len, extra_len);
+            entries.push_back(std::move(entry));
+            p += 46 + name_len + extra_len + comment_len;
+        }
+    }
+
+    inline
+    void read_zip64_extra(Entry& entry, const char* p, uint16_t len) {
+        const char* end = p + len;
+        while (p + 4 <= end) {
+            uint16_t id = read16(p);
+            uint16_t n = read16(p + 2);
+            const char* q = p + 4;
+            if (q + n > end) break;
+            if (id == 0x0001) {
+                const char* qe = q + n;
+                if (entry.size == 0xFFFFFFFF && q + 8 <= qe) {
+                    entry.size = read64(q);
+                    q += 8;
+                }
+                if (entry.compressed_size == 0xFFFFFFFF && q + 8 <= qe) {
+                    entry.compressed_size = read64(q);
+                    q += 8;
+                }
+                if (entry.offset == 0xFFFFFFFF && q + 8 <= qe) {
+                    entry.offset = read64(q);
+                }
+                return;
+            }
+            p = q + n;
+        }
+    }
+
+    static inline
+    uint64_t hash(const StringRef& name) {
+        // fnv-1a
+        uint64_t h = 14695981039346656037ull;
+        for (char c : name) h = (h ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+        return h;
+    }
+
+    inline
+    void build_index() {
+        size_t n = 1;
+        while (n < entries.size() * 2) n <<= 1;
+        slots.assign(n, 0);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            auto& name = entries[i].name;
+            for (size_t k = hash(name) & (n - 1);; k = (k + 1) & (n - 1)) {
+                // a duplicated name refers to the last one.
+                if (slots[k] == 0 || entries[slots[k] - 1].name == name) {
+                    slots[k] = static_cast<uint32_t>(i + 1);
+                    break;
+                }
+            }
+        }
+    }
+
+    // index of the entry, or -1.
+    inline
+    int find(const StringRef& name) const {
+        size_t n = slots.size();
+        for (size_t k = hash(name) & (n - 1); slots[k] != 0; k = (k + 1) & (n - 1)) {
+            if (entries[slots[k] - 1].name == name) return static_cast<int>(slots[k] - 1);
+        }
+        return -1;
+    }
+
+    inline
+    size_t size() const {
+        return entries.size();
+    }
+
+    inline
+    bool is_encrypted(const Entry& entry) const {
+        return (entry.flags & kEncryptedFlag) != 0;
+    }
+
+    // compressed data of entry.
+    inline
+    const char* data(const Entry& entry) {
+        check(entry.offset, 30);
+        const char* h = file.data + entry.offset;
+        if (read32(h) != kLocalFileHeaderSignature) {
+            throw Exception("file=", path, ": entry=", entry.name, ": broken local file header.");
+        }
+        uint64_t offset = entry.offset + 30 + read16(h + 26) + read16(h + 28);
+        check(offset, entry.compressed_size);
+        return file.data + offset;
+    }
+};
+
+}  // namespace xlsx
@@ -200,14 +200,74 @@ struct YamlConfig {
         }
     };
 
+    // a comparison of where, e.g. "platform in [ios, all]" or "enabled == true".
+    // column is a field column, or a column name of the header row.
+    struct Condition {
+        enum Op { kEq, kNe, kLt, kLe, kGt, kGe, kIn, kNotIn };
+        std::string column;
+        Op op = kEq;
+        // one value, or the list of in and not in.
+        std::vector<std::string> values;
+
+        inline explicit Condition(const std::string& expr) {
+            // the first operator after the column. longer ones first at the same position,
+            // so that "<=" is not read as "<". a quoted column may have them in it.
+            static const std::vector<std::pair<std::string, Op>> ops = {
+                {" not in ", kNotIn}, {" in ", kIn}, {"==", kEq}, {"!=", kNe},
+                {"<=", kLe}, {">=", kGe}, {"<", kLt}, {">", kGt},
+            };
+            size_t from = 0;
+            if (!expr.empty() && (expr[0] == '"' || expr[0] == '\'')) {
+                from = std::min(expr.find(expr[0], 1), expr.size());
+            }
+            size_t pos = std::string::npos, len = 0;
+            for (auto& o : ops) {
+                auto p = expr.find(o.first, from);
+                if (p == std::string::npos || (pos != std::string::npos && p >= pos)) continue;
+                pos = p;
+                op = o.second;
+                len = o.first.size();
+            }
+            if (pos == std::string::npos) {
+                throw EXCEPTION("where: ", expr, ": no operator.");
+            }
+            bool list = false;
+            try {
+                column = YAML::Load(expr.substr(0, pos)).as<std::string>();
+                auto rhs = YAML::Load(expr.substr(pos + len));
+                list = rhs.IsSequence();
+                if (list) {
+                    for (auto item : rhs) values.push_back(item.as<std::string>());
+                } else {
+                    values.push_back(rhs.IsNull() ? std::string() : rhs.as<std::string>());
+                }
+            } catch (YAML::Exception& exc) {
+                throw EXCEPTION("where: ", expr, ": ", exc.what());
+            }
+            if (column.empty()) {
+                throw EXCEPTION("where: ", expr, ": no column.");
+            }
+            if ((op == kIn || op == kNotIn) != list) {
+                throw EXCEPTION("where: ", expr, ": in takes a list, and the others a value.");
+            }
+        }
+    };
+
     std::string name;
     std::string path;
     std::string target;
     std::string target_sheet_name;
+    // B5:K2000 or a table name, after '!' of the sheet name. empty: the whole sheet.
+    std::string target_range;
     std::string target_xls_path;
+    // ',' of csv:///, '\t' of tsv:///, or 0 of xls:///.
+    char target_delimiter = 0;
+    // row number of column names. 0: the first row of target_range.
     int row;
     std::vector<Handler> handlers;
     std::vector<Field> fields;
+    // rows are output if all of them hold.
+    std::vector<Condition> where;
 
     ArgConfig arg_config;
 
@@ -236,9 +296,13 @@ struct YamlConfig {
             for (auto& c : name) if (c == '/') c = '_';
         }
         target = doc["target"].as<std::string>();
-        row = doc["row"].as<int>();
+        row = doc["row"] ? doc["row"].as<int>() : 0;
         if (target.substr(0, 7) == "xls:///") {
             target_xls_path = target.substr(7);
+        } else if (target.substr(0, 7) == "csv:///" || target.substr(0, 7) == "tsv:///") {
+            // a sheet named "". "#!B5:K2000" may select a range of it.
+            target_xls_path = target.substr(7);
+            target_delimiter = target[0] == 'c' ? ',' : '\t';
         } else {
             target_xls_path = target;
         }
@@ -247,6 +311,13 @@ struct YamlConfig {
             target_sheet_name = target_xls_path.substr(pos+1);
             target_xls_path = target_xls_path.substr(0, pos);
         }
+        if ((pos = target_sheet_name.rfind('!')) != std::string::npos) {
+            target_range = target_sheet_name.substr(pos+1);
+            target_sheet_name = target_sheet_name.substr(0, pos);
+        }
+        if (row == 0 && target_range.empty()) {
+            throw EXCEPTION(path, ": row is required, unless the target has a range.");
+        }
 
         // handler
         if (auto node = doc["handler"]) {;
@@ -276,6 +347,19 @@ struct YamlConfig {
             }
         }
 
+        // where: "platform in [ios, all]", or a list of those.
+        if (auto node = doc["where"]) {
+            try {
+                if (node.IsSequence()) {
+                    for (auto child : node) where.emplace_back(child.as<std::string>());
+                } else {
+                    where.emplace_back(node.as<std::string>());
+                }
+            } catch (std::exception& exc) {
+                throw EXCEPTION(path, ": ", exc.what());
+            }
+        }
+
         if (handlers[0].sort_keys) {
             std::sort(fields.begin(), fields.end(), [](Field& a, Field& b) {
                 return a.column < b.column;
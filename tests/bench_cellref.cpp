@@ -0,0 +1,70 @@
+#include <chrono>
+#include <tuple>
+#include "utils.hpp"
+#include "xlsx.hpp"
+
+// decoding of cell references, compared with the substr and std::stoi one it replaced.
+// usage: bench_cellref.exe [n]
+std::tuple<int, int> legacy_parse_cellname(std::string r) {
+    size_t p = std::string::npos;
+    int colx = 0;
+    for (size_t i = 0; i < r.size(); ++i) {
+        uint8_t c = r[i];
+        if ('A' <= c && c <= 'Z') {
+            colx = colx * ('Z' - 'A' + 1) + (c - 'A' + 1);
+        } else if ('0' <= c && c <= '9') {
+            p = i;
+            break;
+        } else {
+            throw xlsx::Exception("bad position char. row");
+        }
+    }
+    colx--;
+    if (p == std::string::npos) {
+        throw xlsx::Exception("bad position char. col");
+    }
+    int rowx = std::stoi(r.substr(p)) - 1;
+    return std::make_tuple(rowx, colx);
+}
+
+int main(int argc, char** argv) {
+    using namespace xlsxconverter;
+
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    // as they are read from <c r="...">.
+    std::vector<std::string> refs;
+    for (int j = 0; j < n / 50; ++j) {
+        for (int i = 0; i < 50; ++i) {
+            std::string col;
+            for (int k = i + 1; k > 0; k = (k - 1) / 26) {
+                col.insert(col.begin(), 'A' + (k - 1) % 26);
+            }
+            refs.push_back(col + std::to_string(j + 1));
+        }
+    }
+
+    int64_t sum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (auto& ref : refs) {
+        int rowx, colx;
+        std::tie(rowx, colx) = legacy_parse_cellname(ref);
+        sum += rowx + colx;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    int failed = 0;
+    for (auto& ref : refs) {
+        int rowx = 0, colx = 0;
+        if (!xlsx::CellRef::parse(ref.data(), ref.data() + ref.size(), rowx, colx)) ++failed;
+        sum -= rowx + colx;
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    auto ns = [&](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count() / refs.size();
+    };
+    bool matched = sum == 0 && failed == 0;
+    utils::log("refs: ", refs.size(), (matched ? "" : " MISMATCH"));
+    utils::log("substr+stoi: ", ns(t1 - t0), "ns/ref");
+    utils::log("CellRef: ", ns(t2 - t1), "ns/ref");
+    return matched ? 0 : 1;
+}
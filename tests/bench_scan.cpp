@@ -0,0 +1,122 @@
+#include <chrono>
+#include <functional>
+#include "utils.hpp"
+#include "xlsx.hpp"
+
+// throughput of the xml tokenizer on each scan level, compared with pugixml as load_doc uses it.
+// usage: bench_scan.exe [nrows]
+double best_seconds(const std::function<void()>& f) {
+    double best = 1e9;
+    for (int i = 0; i < 5; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        f();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+void report(const char* name, size_t bytes, double seconds, int64_t check) {
+    xlsxconverter::utils::log(name, ": ", static_cast<int64_t>(bytes / seconds / (1 << 20)),
+                              " MB/s (", static_cast<int64_t>(seconds * 1000), "ms) check=",
+                              check);
+}
+
+int main(int argc, char** argv) {
+    int nrows = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    // as excel writes them: shared strings, numbers, dates and a few inline strings.
+    std::string sheet =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\r\n"
+        "<worksheet xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\">"
+        "<dimension ref=\"A1:T" + std::to_string(nrows) + "\"/><sheetData>";
+    std::string sst = "<sst xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\">";
+    for (int j = 0; j < nrows; ++j) {
+        auto r = std::to_string(j + 1);
+        sheet += "<row r=\"" + r + "\" spans=\"1:20\">";
+        for (int i = 0; i < 20; ++i) {
+            std::string ref = xlsx::CellRef::name(j, i);
+            switch (i % 4) {
+                case 0:
+                    sheet += "<c r=\"" + ref + "\" s=\"3\" t=\"s\"><v>" +
+                             std::to_string(j * 5 + i / 4) + "</v></c>";
+                    break;
+                case 1:
+                    sheet += "<c r=\"" + ref + "\"><v>" + std::to_string(j * 1.25 + i) +
+                             "</v></c>";
+                    break;
+                case 2:
+                    sheet += "<c r=\"" + ref + "\" s=\"7\"><v>" + std::to_string(42000 + j) +
+                             "</v></c>";
+                    break;
+                default:
+                    sheet += "<c r=\"" + ref + "\" t=\"inlineStr\"><is><t>item &amp; " + r +
+                             "</t></is></c>";
+            }
+        }
+        sheet += "</row>";
+        for (int k = 0; k < 5; ++k) {
+            sst += "<si><t>name of the item number " + std::to_string(j * 5 + k) +
+                   " in the master data</t></si>";
+        }
+    }
+    sheet += "</sheetData></worksheet>";
+    sst += "</sst>";
+    xlsxconverter::utils::log("sheet: ", sheet.size(), " bytes, sharedStrings: ", sst.size(),
+                              " bytes");
+
+    int64_t check = 0;
+    auto seconds = best_seconds([&]() {
+        pugi::xml_document doc;
+        doc.load_buffer(sheet.data(), sheet.size());
+        check = 0;
+        for (auto row : doc.child("worksheet").child("sheetData").children("row")) {
+            for (auto c : row.children("c")) check += std::strlen(c.child("v").text().get());
+        }
+    });
+    report("pugixml sheet", sheet.size(), seconds, check);
+
+    seconds = best_seconds([&]() {
+        pugi::xml_document doc;
+        doc.load_buffer(sst.data(), sst.size());
+        check = 0;
+        for (auto si : doc.child("sst").children("si")) {
+            check += std::strlen(si.child("t").text().get());
+        }
+    });
+    report("pugixml sharedStrings", sst.size(), seconds, check);
+
+    const char* names[] = {"scalar", "sse2", "avx2"};
+    for (int level = 0; level <= static_cast<int>(xlsx::Scan::detect()); ++level) {
+        xlsx::Scan::select(static_cast<xlsx::Scan::Level>(level));
+        xlsxconverter::utils::log("[", names[level], "]");
+
+        seconds = best_seconds([&]() {
+            auto p = sheet.data(), e = p + sheet.size();
+            check = 0;
+            while ((p = xlsx::Scan::find3(p, e, '<', '"', '&')) != e) {
+                ++check;
+                ++p;
+            }
+        });
+        report("find3 kernel", sheet.size(), seconds, check);
+
+        seconds = best_seconds([&]() {
+            xlsx::SheetReader reader(sheet.data(), sheet.size());
+            xlsx::RawRow row;
+            check = 0;
+            while (reader.next_row(row)) {
+                for (size_t i = 0; i < row.size(); ++i) check += row[i].v.size();
+            }
+        });
+        report("SheetReader", sheet.size(), seconds, check);
+
+        seconds = best_seconds([&]() {
+            xlsx::SharedStrings strings(sst);
+            check = 0;
+            for (size_t i = 0; i < strings.size(); ++i) check += strings.at(i).size;
+        });
+        report("SharedStrings", sst.size(), seconds, check);
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include <chrono>
+#include "utils.hpp"
+#include "xlsx.hpp"
+
+// memory of the cell store of Sheet, compared with the vector<vector<Cell>> it replaced.
+// usage: bench_sheet.exe [xlsx] [sheet]
+struct LegacyCell {
+    std::string v;
+    int row;
+    int col;
+    int type;
+};
+
+int main(int argc, char** argv) {
+    using namespace xlsxconverter;
+    using namespace xlsxconverter::utils;
+
+    std::string path = argc > 1 ? argv[1] : "tests/xlsx/sample.xlsx";
+    std::string name = argc > 2 ? argv[2] : "test";
+
+    auto t0 = std::chrono::steady_clock::now();
+    xlsx::Workbook book(path);
+    auto& sheet = book.sheet_by_name(name);
+    auto t1 = std::chrono::steady_clock::now();
+
+    size_t ncells = 0;
+    size_t legacy = sheet.nrows() * sizeof(std::vector<LegacyCell>);
+    for (int j = 0; j < sheet.nrows(); ++j) {
+        for (int i = 0; i < sheet.ncols(); ++i) {
+            auto cell = sheet.cell(j, i);
+            legacy += sizeof(LegacyCell);
+            if (cell.type == xlsx::Cell::Type::kEmpty) continue;
+            ++ncells;
+            // every text was copied into the cell. short ones fit in SSO.
+            size_t n = cell.text().size;
+            if (n >= sizeof(std::string) / 2) legacy += (n + 1 + 15) / 16 * 16;
+        }
+    }
+    auto store = sheet.memory_usage();
+
+    utils::log("sheet: ", name, " ", sheet.nrows(), "x", sheet.ncols(), " cells=", ncells);
+    utils::log("load: ", std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count(),
+               "ms");
+    utils::log("vector<vector<Cell>>: ", legacy, " bytes (estimated)");
+    utils::log("column store: ", store, " bytes");
+    utils::log("saved: ", legacy - store, " bytes (", (legacy - store) * 100 / legacy, "%)");
+    return 0;
+}
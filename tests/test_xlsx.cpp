@@ -1,3 +1,4 @@
+#include <utime.h>
 #include <boost/assert.hpp>
 #include "utils.hpp"
 #include "xlsx.hpp"
@@ -6,14 +7,14 @@ int main(int argc, char** argv) {
     using namespace xlsxconverter;
     using namespace xlsxconverter::utils;
 
-    auto book = xlsx::Workbook("test/sample.xlsx");
+    xlsx::Workbook book("tests/xlsx/sample.xlsx");
     auto& sheet = book.sheet_by_name("test");
 
     utils::log("ncols: ", sheet.ncols());
     utils::log("nrows: ", sheet.nrows());
     for (int j = 0; j < sheet.nrows(); ++j) {
         for (int i = 0; i < sheet.ncols(); ++i) {
-            auto& cell = sheet.cell(j, i);
+            auto cell = sheet.cell(j, i);
             if (cell.type == xlsx::Cell::Type::kEmpty) continue;
             utils::log("cell[", cell.cellname(), "]=", cell.as_str());
         }
@@ -23,5 +24,478 @@ int main(int argc, char** argv) {
     BOOST_ASSERT(sheet.cell("ZZ1").as_str() == "ZZ1");
     BOOST_ASSERT(sheet.cell("AAA1").as_str() == "AAA1");
 
+    // a row view reads the same cells.
+    auto row = sheet.row(0);
+    BOOST_ASSERT(row.size() == sheet.ncols());
+    BOOST_ASSERT(row[0].as_str() == sheet.cell("A1").as_str());
+    BOOST_ASSERT(&book.sheet_by_name("test") == &sheet);
+
+    // streaming mode reads the same cells.
+    int nrows = 0;
+    book.each_row("test", [&](xlsx::Row& row) {
+        ++nrows;
+        for (int i = 0; i < sheet.ncols(); ++i) {
+            BOOST_ASSERT(row.cell(i).type == sheet.cell(row.index, i).type);
+            BOOST_ASSERT(row.cell(i).as_str() == sheet.cell(row.index, i).as_str());
+        }
+    });
+    BOOST_ASSERT(nrows > 0);
+
+    // a snapshot reads the same cells without the shared strings, and only with its key.
+    std::string snapshot = "test_xlsx.snapshot";
+    BOOST_ASSERT(xlsx::Snapshot::write(snapshot, "key", sheet.nrows(), sheet.ncols(),
+                                       sheet.detached_columns()));
+    int snap_nrows = 0, snap_ncols = 0;
+    std::vector<xlsx::ColumnStore> snap_columns;
+    BOOST_ASSERT(!xlsx::Snapshot::read(snapshot, "other", snap_nrows, snap_ncols, snap_columns));
+    BOOST_ASSERT(xlsx::Snapshot::read(snapshot, "key", snap_nrows, snap_ncols, snap_columns));
+    BOOST_ASSERT(snap_columns[0].is_mapped() && snap_columns[0].memory_usage() < 1024);
+    xlsx::Sheet snap("rid", "test", snap_nrows, snap_ncols, std::move(snap_columns),
+                     nullptr, nullptr);
+    BOOST_ASSERT(snap.nrows() == sheet.nrows() && snap.ncols() == sheet.ncols());
+    for (int j = 0; j < sheet.nrows(); ++j) {
+        for (int i = 0; i < sheet.ncols(); ++i) {
+            BOOST_ASSERT(snap.cell(j, i).type == sheet.cell(j, i).type);
+            BOOST_ASSERT(snap.cell(j, i).as_str() == sheet.cell(j, i).as_str());
+        }
+    }
+    // the mapping is released with the last column of it.
+    snap.columns.clear();
+    // a cell out of its column text, or a last row out of the sheet, is a broken snapshot.
+    xlsx::ColumnStore text_column;
+    text_column.set_text(0, xlsx::Cell::Type::kString, "abc");
+    text_column.set_number(1, xlsx::Cell::Type::kInt, "5", 5);
+    BOOST_ASSERT(xlsx::Snapshot::write(snapshot, "key", 2, 1,
+                                       std::vector<xlsx::ColumnStore>{text_column}));
+    std::string snap_bytes = utils::fs::readfile(snapshot);
+    // magic, key_size, key, nrows, ncols, ncolumns, then last_row nbits ntags ntext bits[1].
+    const size_t last_row_at = 48, values_at = 88;
+    auto read_patched = [&](size_t at, uint64_t v) {
+        std::string bytes = snap_bytes;
+        std::memcpy(&bytes[at], &v, sizeof(v));
+        utils::fs::writefile(snapshot, bytes);
+        return xlsx::Snapshot::read(snapshot, "key", snap_nrows, snap_ncols, snap_columns);
+    };
+    BOOST_ASSERT(read_patched(last_row_at, 1));
+    BOOST_ASSERT(snap_columns[0].text_at(1).str() == "5" && snap_columns[0].number_at(1) == 5);
+    BOOST_ASSERT(!read_patched(last_row_at, 2));
+    BOOST_ASSERT(!read_patched(values_at, (uint64_t(1) << 32) | 100));
+    BOOST_ASSERT(!read_patched(values_at + 8, 1));
+    std::remove(snapshot.c_str());
+
+    // a workbook writes the snapshot of a sheet on first open, and maps it on the next one.
+    // a changed mtime or entry crc is not served from it.
+    std::string table_bytes = utils::fs::readfile("tests/xlsx/table.xlsx");
+    std::string snap_copy = "test_snapshot.xlsx";
+    auto write_copy = [&](const std::string& bytes, time_t mtime) {
+        utils::fs::writefile(snap_copy, bytes);
+        struct utimbuf times = {mtime, mtime};
+        BOOST_ASSERT(::utime(snap_copy.c_str(), &times) == 0);
+    };
+    xlsx::Workbook::Options snapshot_options;
+    snapshot_options.snapshot_dir = ".";
+    std::string snap_file;
+    auto open_mapped = [&]() {
+        xlsx::Workbook snap_book(snap_copy, snapshot_options);
+        auto& items = snap_book.sheet_by_name("items");
+        BOOST_ASSERT(items.cell("C6").as_str() == "apple" && items.cell("D8").as_double() == 3.5);
+        snap_file = xlsx::Snapshot::filename(".", snap_book.path, "items");
+        return items.columns[1].is_mapped();
+    };
+    write_copy(table_bytes, 1500000000);
+    BOOST_ASSERT(!open_mapped() && utils::fs::exists(snap_file));
+    BOOST_ASSERT(open_mapped());
+    write_copy(table_bytes, 1500000001);
+    BOOST_ASSERT(!open_mapped());
+    BOOST_ASSERT(open_mapped());
+    // the crc of the sheet in both of its headers, as a changed entry of the same size.
+    std::string patched = table_bytes;
+    std::string entry = "xl/worksheets/sheet1.xml";
+    for (size_t at = patched.find(entry); at != std::string::npos;
+         at = patched.find(entry, at + 1)) {
+        if (at >= 30 && patched.compare(at - 30, 4, "PK\x03\x04") == 0) patched[at - 30 + 14] ^= 1;
+        if (at >= 46 && patched.compare(at - 46, 4, "PK\x01\x02") == 0) patched[at - 46 + 16] ^= 1;
+    }
+    write_copy(patched, 1500000001);
+    // decoded again, which fails the check of the crc.
+    bool snap_thrown = false;
+    try {
+        open_mapped();
+    } catch (xlsx::Exception& exc) {
+        snap_thrown = std::string(exc.what()).find("crc mismatch") != std::string::npos;
+    }
+    BOOST_ASSERT(snap_thrown);
+    std::remove(snap_file.c_str());
+    std::remove(snap_copy.c_str());
+
+    // lazy open reads sharedStrings and styles on first use.
+    xlsx::Workbook::Options lazy_options;
+    lazy_options.lazy = true;
+    xlsx::Workbook lazy_book("tests/xlsx/sample.xlsx", lazy_options);
+    BOOST_ASSERT(!lazy_book.shared_string->loaded() && !lazy_book.style_sheet->loaded());
+    BOOST_ASSERT(lazy_book.sheet_by_name("test").cell("ZZ1").as_str() == "ZZ1");
+    BOOST_ASSERT(lazy_book.shared_string->loaded());
+
+    // an entry is checked by its crc32, on each kernel.
+    for (auto level : {xlsx::Crc32::Level::kTable, xlsx::Crc32::detect()}) {
+        xlsx::Crc32::select(level);
+        auto entry = book.open_entry(book.entry_index("xl/workbook.xml"));
+        entry->expected_crc ^= 1;
+        bool thrown = false;
+        try {
+            entry->finish();
+        } catch (xlsx::Exception&) {
+            thrown = true;
+        }
+        BOOST_ASSERT(thrown);
+        std::string text(1000, 'x');
+        BOOST_ASSERT(xlsx::Crc32::update(xlsx::Crc32::update(0, text.data(), 100),
+                                         text.data() + 100, 900) ==
+                     crc32(0, reinterpret_cast<const Bytef*>(text.data()), 1000));
+    }
+    xlsx::Crc32::select(xlsx::Crc32::detect());
+
+    // a verified entry is recorded, and not checked again while the file is unchanged.
+    xlsx::Workbook::Options verified_options;
+    verified_options.snapshot_dir = ".";
+    verified_options.skip_verified = true;
+    {
+        xlsx::Workbook first("tests/xlsx/sample.xlsx", verified_options);
+        BOOST_ASSERT(first.open_entry(first.entry_index("xl/worksheets/sheet5.xml"))->verify);
+        first.read_entry("xl/worksheets/sheet5.xml");
+        first.read_entry("xl/worksheets/sheet3.xml");
+        // written once, as the workbook is closed.
+        BOOST_ASSERT(first.verified_changed && !utils::fs::exists(first.verified_file));
+    }
+    xlsx::Workbook second("tests/xlsx/sample.xlsx", verified_options);
+    BOOST_ASSERT(!second.open_entry(second.entry_index("xl/worksheets/sheet5.xml"))->verify);
+    BOOST_ASSERT(!second.open_entry(second.entry_index("xl/worksheets/sheet3.xml"))->verify);
+    BOOST_ASSERT(second.open_entry(second.entry_index("xl/worksheets/sheet4.xml"))->verify);
+    std::remove(second.verified_file.c_str());
+
+    // a binary workbook reads into the same cells as xlsx.
+    xlsx::Workbook xlsb("tests/xlsx/sample.xlsb");
+    auto& bin = xlsb.sheet_by_name("test");
+    BOOST_ASSERT(bin.nrows() == 4 && bin.ncols() == 5);
+    BOOST_ASSERT(bin.cell("A1").as_str() == "w\xC3\xB6rld \xF0\x9F\x98\x80");
+    BOOST_ASSERT(bin.cell("E1").as_str() == "hello");
+    BOOST_ASSERT(bin.cell("B1").type == xlsx::Cell::Type::kInt && bin.cell("B1").as_int() == 42);
+    BOOST_ASSERT(bin.cell("C1").as_double() == 1.5);
+    BOOST_ASSERT(bin.cell("D1").type == xlsx::Cell::Type::kBool);
+    BOOST_ASSERT(bin.cell("A2").as_str() == "inline");
+    BOOST_ASSERT(bin.cell("B2").as_double() == 12.34);
+    BOOST_ASSERT(bin.cell("C2").type == xlsx::Cell::Type::kDateTime);
+    BOOST_ASSERT(bin.cell("A4").type == xlsx::Cell::Type::kDateTime);
+    BOOST_ASSERT(bin.cell("D2").as_str() == "#DIV/0!");
+    BOOST_ASSERT(bin.cell("E2").as_double() == -0.1);
+    BOOST_ASSERT(bin.cell("B4").as_str() == "1E-5");
+    BOOST_ASSERT(bin.cell("C4").type == xlsx::Cell::Type::kEmpty);
+    BOOST_ASSERT(bin.cell("D4").type == xlsx::Cell::Type::kString);
+    BOOST_ASSERT(bin.cell("D4").as_str() == "rich");
+    BOOST_ASSERT(bin.cell("A3").type == xlsx::Cell::Type::kEmpty);
+    int bin_nrows = 0;
+    xlsb.each_row("test", [&](xlsx::Row& row) {
+        ++bin_nrows;
+        for (int i = 0; i < bin.ncols(); ++i) {
+            BOOST_ASSERT(row.cell(i).as_str() == bin.cell(row.index, i).as_str());
+        }
+    });
+    BOOST_ASSERT(bin_nrows == 3);
+    xlsx::CellRange bin_range;
+    xlsx::CellRange::parse("B1:C2", bin_range);
+    auto& bin_bounded = xlsb.sheet_by_name("test", bin_range);
+    BOOST_ASSERT((bin_bounded.row_indexes() == std::vector<int>{0, 1}));
+    BOOST_ASSERT(bin_bounded.cell("B1").as_int() == 42 && bin_bounded.cell("C2").type ==
+                 xlsx::Cell::Type::kDateTime);
+    BOOST_ASSERT(bin_bounded.cell("A1").type == xlsx::Cell::Type::kEmpty);
+    BOOST_ASSERT(bin_bounded.cell("D1").type == xlsx::Cell::Type::kEmpty);
+
+    // numbers are parsed once, as std::stoll/std::stod read them.
+    BOOST_ASSERT(xlsx::Number::parse("-42").i == -42);
+    BOOST_ASSERT(xlsx::Number::parse("1.5E+3").d == 1500.0);
+    BOOST_ASSERT(xlsx::Number::parse("0.1").d == std::stod("0.1"));
+    BOOST_ASSERT(xlsx::Number::parse("1e999").kind == xlsx::Number::Kind::kInvalid);
+    BOOST_ASSERT(xlsx::Number::parse("1.2.3").kind == xlsx::Number::Kind::kInvalid);
+
+    // shared strings are decoded on first reference.
+    xlsx::SharedStrings sst(
+        "<sst><si><t>a&amp;b</t></si><si/>"
+        "<si><r><t>x</t></r><r><rPr/><t xml:space=\"preserve\"> y</t></r>"
+        "<rPh><t>z</t></rPh></si></sst>");
+    BOOST_ASSERT(sst.size() == 3);
+    BOOST_ASSERT(sst.at(2).str() == "x y");
+    BOOST_ASSERT(sst.at(0).str() == "a&b");
+    BOOST_ASSERT(sst.at(1).empty());
+    BOOST_ASSERT(sst.at(2).data == sst.at(2).data);
+
+    // a table split at <si> is indexed the same on several threads, and decoded on demand.
+    std::string big = "<?xml version=\"1.0\"?><sst count=\"3000\">";
+    for (int i = 0; i < 1000; ++i) {
+        big += "<si><t>plain " + std::to_string(i) + "</t></si><si/>"
+               "<si><r><t>rich</t></r><r><t xml:space=\"preserve\"> &lt;" + std::to_string(i) +
+               "&gt;</t></r><rPh><t>ph</t></rPh></si>";
+    }
+    big += "</sst>";
+    xlsx::SharedStrings serial(big);
+    xlsx::SharedStrings parallel([&](xlsx::SharedStrings& table) {
+        table.xml = big;
+        BOOST_ASSERT(table.index_parallel(4));
+    });
+    BOOST_ASSERT(parallel.size() == 3000 && serial.size() == 3000);
+    BOOST_ASSERT(parallel.offsets == serial.offsets && parallel.ptrs[2].load() == nullptr);
+    for (size_t i = 0; i < serial.size(); ++i) {
+        BOOST_ASSERT(parallel.at(i).str() == serial.at(i).str());
+    }
+    BOOST_ASSERT(parallel.at(2).str() == "rich <0>");
+    xlsx::SharedStrings commented([&](xlsx::SharedStrings& table) {
+        table.xml = big + "<!-- <si> -->";
+        BOOST_ASSERT(!table.index_parallel(4) && table.offsets.empty());
+        table.index();
+    });
+    BOOST_ASSERT(commented.size() == 3000);
+    // a loader which threw runs again on the next use, from scratch.
+    std::string truncated = "<sst><si><t>a</t></si><si><t>b</t></si><!-- ";
+    int truncated_loads = 0;
+    xlsx::SharedStrings retried([&](xlsx::SharedStrings& table) {
+        table.load_xml(++truncated_loads < 3 ? truncated : truncated + "-->");
+    });
+    for (int k = 0; k < 2; ++k) {
+        std::string message;
+        try {
+            retried.size();
+        } catch (xlsx::Exception& exc) {
+            message = exc.what();
+        }
+        BOOST_ASSERT(message.find("unexpected eof") != std::string::npos);
+    }
+    BOOST_ASSERT(retried.size() == 2 && retried.at(1).str() == "b" && truncated_loads == 3);
+
+    // cell references, and positions of rows and cells without them.
+    int rowx = 0, colx = 0;
+    std::string ref = "XFD1048576";
+    BOOST_ASSERT(xlsx::CellRef::parse(ref.data(), ref.data() + ref.size(), rowx, colx));
+    BOOST_ASSERT(rowx == 1048575 && colx == 16383);
+    for (std::string bad : {"", "A", "12", "a1", "A0", "A1B", "ABCDE1", "A1234567890"}) {
+        BOOST_ASSERT(!xlsx::CellRef::parse(bad.data(), bad.data() + bad.size(), rowx, colx));
+    }
+    std::string xml =
+        "<worksheet><sheetData>"
+        "<row r=\"2\"><c><v>1</v></c><c r=\"D2\"><v>2</v></c><c><v>3</v></c></row>"
+        "<row><c><v>4</v></c></row>"
+        "</sheetData></worksheet>";
+    xlsx::SheetReader reader(xml.data(), xml.size());
+    xlsx::RawRow raw;
+    BOOST_ASSERT(reader.next_row(raw) && raw.index == 1 && raw.size() == 3);
+    BOOST_ASSERT(raw[0].col == 0 && raw[1].col == 3 && raw[2].col == 4);
+    BOOST_ASSERT(reader.next_row(raw) && raw.index == 2 && raw[0].col == 0);
+    BOOST_ASSERT(reader.implicit_rows && !reader.next_row(raw));
+    // a shared string of an invalid index is an error of the cell, in a sheet and in a row.
+    auto small_strings = std::make_shared<xlsx::SharedStrings>("<sst><si><t>a</t></si></sst>");
+    for (std::string v : {"x", "1", "-1", "99999999999999999999"}) {
+        std::string bad_xml = "<worksheet><dimension ref=\"A1:B1\"/><sheetData>"
+                              "<row r=\"1\"><c r=\"B1\" t=\"s\"><v>" + v + "</v></c></row>"
+                              "</sheetData></worksheet>";
+        xlsx::SheetReader bad_reader(bad_xml.data(), bad_xml.size());
+        std::string message;
+        try {
+            xlsx::Sheet("rid", "bad", bad_reader, small_strings, nullptr);
+        } catch (xlsx::Exception& exc) {
+            message = exc.what();
+        }
+        BOOST_ASSERT(message.find("invalid shared_string") != std::string::npos);
+        BOOST_ASSERT(message.find("cell=B1") != std::string::npos);
+        bool thrown = false;
+        try {
+            xlsx::Cell(0, 1, v, "s", 0, small_strings, nullptr);
+        } catch (xlsx::Exception&) {
+            thrown = true;
+        }
+        BOOST_ASSERT(thrown);
+    }
+
+    // a sheetData over kParallelDecodeSize decodes the same on several threads, in row order.
+    std::string large = "<worksheet><dimension ref=\"A1:E50000\"/><sheetData>";
+    for (int j = 0; j < 50000; ++j) {
+        auto r = std::to_string(j + 1);
+        large += "<row r=\"" + r + "\"><c r=\"A" + r + "\"><v>" + r + "</v></c>";
+        if (j % 7 != 0) large += "<c r=\"B" + r + "\"><v>" + std::to_string(j * 0.25) + "</v></c>";
+        large += "<c r=\"C" + r + "\" t=\"inlineStr\"><is><t>item &amp; " + r + "</t></is></c>"
+                 "<c r=\"D" + r + "\" t=\"s\"><v>" + std::to_string(j % 3000) + "</v></c>"
+                 "<c r=\"E" + r + "\" t=\"str\"><v>formula of the row " + r + "</v></c></row>";
+    }
+    large += "</sheetData></worksheet>";
+    BOOST_ASSERT(large.size() > xlsx::Sheet::kParallelDecodeSize);
+    auto large_strings = std::make_shared<xlsx::SharedStrings>(big);
+    xlsx::SheetReader serial_reader(large.data(), large.size());
+    xlsx::Sheet serial_sheet("rid", "large", serial_reader, large_strings, nullptr);
+    xlsx::SheetReader parallel_reader(large.data(), large.size());
+    xlsx::Sheet parallel_sheet("rid", "large", parallel_reader, large_strings, nullptr, 4);
+    BOOST_ASSERT(serial_sheet.decoded_chunks == 1 && parallel_sheet.decoded_chunks == 4);
+    BOOST_ASSERT(parallel_sheet.row_indexes() == serial_sheet.row_indexes());
+    BOOST_ASSERT(parallel_sheet.nrows() == 50000 && parallel_sheet.ncols() == 5);
+    for (int j = 0; j < serial_sheet.nrows(); ++j) {
+        for (int i = 0; i < serial_sheet.ncols(); ++i) {
+            auto expected = serial_sheet.cell(j, i);
+            auto actual = parallel_sheet.cell(j, i);
+            BOOST_ASSERT(actual.type == expected.type && actual.as_str() == expected.as_str());
+        }
+    }
+    BOOST_ASSERT(parallel_sheet.cell("C50000").as_str() == "item & 50000");
+    // no thread is idle for it in a process of busy jobs.
+    xlsx::ThreadBudget::global().limit(0);
+    xlsx::SheetReader busy_reader(large.data(), large.size());
+    xlsx::Sheet busy_sheet("rid", "large", busy_reader, large_strings, nullptr, 4);
+    BOOST_ASSERT(busy_sheet.decoded_chunks == 1);
+    xlsx::ThreadBudget::global().release(1);
+    BOOST_ASSERT(xlsx::ThreadBudget::global().acquire(3) == 1);
+    xlsx::ThreadBudget::global().limit(-1);
+
+    // a dimension of the whole sheet costs only the rows and columns which have cells.
+    std::string wide =
+        "<worksheet><dimension ref=\"A1:XFD1048576\"/><sheetData>"
+        "<row r=\"1\"><c r=\"A1\"><v>1</v></c></row>"
+        "<row r=\"3\" customHeight=\"1\"/>"
+        "<row r=\"100000\"><c r=\"C100000\"><v>2</v></c></row>"
+        "</sheetData></worksheet>";
+    xlsx::SheetReader wide_reader(wide.data(), wide.size());
+    xlsx::Sheet wide_sheet("rid", "wide", wide_reader, nullptr, nullptr);
+    BOOST_ASSERT(wide_sheet.nrows() == 1048576 && wide_sheet.ncols() == 16384);
+    BOOST_ASSERT((wide_sheet.row_indexes() == std::vector<int>{0, 99999}));
+    BOOST_ASSERT(wide_sheet.cell("C100000").as_str() == "2");
+    BOOST_ASSERT(wide_sheet.cell("XFD1048576").type == xlsx::Cell::Type::kEmpty);
+    BOOST_ASSERT(wide_sheet.cell("XFD1048576").cellname() == "XFD1048576");
+    BOOST_ASSERT(wide_sheet.memory_usage() < 64 * 1024);
+
+    // rows of formats or of unmapped columns only are not listed, nor read as cells.
+    std::string formatted =
+        "<worksheet><dimension ref=\"A1:C65536\"/><sheetData>"
+        "<row r=\"1\"><c r=\"A1\"><v>1</v></c><c r=\"B1\" s=\"1\"/></row>"
+        "<row r=\"2\"><c r=\"C2\"><v>note</v></c></row>"
+        "<row r=\"3\"><c r=\"A3\" s=\"1\"/><c r=\"B3\" s=\"1\"></c></row>"
+        "<row r=\"4\"><c r=\"B4\"><v>2</v></c></row>"
+        "<row r=\"65536\"><c r=\"A65536\" s=\"1\"/></row>"
+        "</sheetData></worksheet>";
+    xlsx::SheetReader formatted_reader(formatted.data(), formatted.size());
+    BOOST_ASSERT(formatted_reader.next_row(raw) && raw.size() == 1 && raw[0].col == 0);
+    BOOST_ASSERT(formatted_reader.next_row(raw) && raw.size() == 1);
+    BOOST_ASSERT(formatted_reader.next_row(raw) && raw.index == 2 && raw.size() == 0);
+    xlsx::SheetReader formatted_decoder(formatted.data(), formatted.size());
+    xlsx::Sheet formatted_sheet("rid", "formatted", formatted_decoder, nullptr, nullptr);
+    BOOST_ASSERT((formatted_sheet.row_indexes() == std::vector<int>{0, 1, 3}));
+    BOOST_ASSERT((formatted_sheet.row_indexes({0, 1, -1}) == std::vector<int>{0, 3}));
+    BOOST_ASSERT((formatted_sheet.row_indexes({1, 5}) == std::vector<int>{3}));
+    BOOST_ASSERT(formatted_sheet.row_indexes().back() == 3 && formatted_sheet.nrows() == 65536);
+
+    // a range or a table bounds the rows and cells which are decoded.
+    xlsx::CellRange range;
+    BOOST_ASSERT(xlsx::CellRange::parse("B5:K2000", range) && range.ref() == "B5:K2000");
+    BOOST_ASSERT(range.first_row == 4 && range.first_col == 1);
+    BOOST_ASSERT(range.last_row == 1999 && range.last_col == 10);
+    BOOST_ASSERT(xlsx::CellRange::parse("C3", range) && range.ref() == "C3:C3");
+    for (std::string bad : {"", "Items", "B5:", "K2000:B5", "B5:K2000:Z9"}) {
+        BOOST_ASSERT(!xlsx::CellRange::parse(bad, range));
+    }
+    BOOST_ASSERT(xlsx::CellRange().whole() && xlsx::CellRange().ref().empty());
+    BOOST_ASSERT(xlsx::Workbook::resolve_part("xl/worksheets/", "../tables/table1.xml") ==
+                 "xl/tables/table1.xml");
+    BOOST_ASSERT(xlsx::Workbook::resolve_part("xl/worksheets/", "/xl/tables/t.xml") ==
+                 "xl/tables/t.xml");
+    xlsx::CellRange::parse("B2:C3", range);
+    xlsx::SheetReader bounded(xml.data(), xml.size());
+    bounded.bounds = &range;
+    BOOST_ASSERT(bounded.next_row(raw) && raw.index == 1 && raw.size() == 0);
+    BOOST_ASSERT(bounded.next_row(raw) && raw.index == 2 && raw.size() == 0);
+    BOOST_ASSERT(!bounded.next_row(raw) && bounded.done);
+
+    xlsx::Workbook tables("tests/xlsx/table.xlsx");
+    range = tables.range_by_name("items", "Items");
+    BOOST_ASSERT(range.ref() == "B5:D8");
+    BOOST_ASSERT(tables.range_by_name("items", "").whole());
+    auto& items = tables.sheet_by_name("items", range);
+    BOOST_ASSERT(&items != &tables.sheet_by_name("items"));
+    BOOST_ASSERT(&items == &tables.sheet_by_name("items", range));
+    BOOST_ASSERT((items.row_indexes() == std::vector<int>{4, 5, 6, 7}));
+    BOOST_ASSERT(items.cell("C6").as_str() == "apple" && items.cell("D8").as_double() == 3.5);
+    BOOST_ASSERT(items.cell("A6").type == xlsx::Cell::Type::kEmpty);
+    BOOST_ASSERT(items.cell("F5").type == xlsx::Cell::Type::kEmpty);
+    BOOST_ASSERT(tables.sheet_by_name("items").cell("XFD7").as_str() == "far");
+    int item_rows = 0;
+    tables.each_row("items", [&](xlsx::Row& row) {
+        ++item_rows;
+        BOOST_ASSERT(range.contains_row(row.index) && row.cell(0).type == xlsx::Cell::Type::kEmpty);
+        BOOST_ASSERT(row.cell(2).as_str() == items.cell(row.index, 2).as_str());
+    }, nullptr, &range);
+    BOOST_ASSERT(item_rows == 4);
+    // a filter reads its cells first, and a kept row has them and the others once decoded.
+    xlsx::RowFilter not_banana;
+    not_banana.columns.set({2});
+    not_banana.first_row = 5;
+    not_banana.accept = [](xlsx::Row& row) {
+        BOOST_ASSERT(row.cell(1).type == xlsx::Cell::Type::kEmpty);
+        return row.cell(2).as_str() != "banana";
+    };
+    std::vector<int> kept_rows;
+    tables.each_row("items", [&](xlsx::Row& row) {
+        kept_rows.push_back(row.index);
+        for (int i = 0; i < 4; ++i) {
+            BOOST_ASSERT(row.cell(i).type == items.cell(row.index, i).type);
+            BOOST_ASSERT(row.cell(i).as_str() == items.cell(row.index, i).as_str());
+        }
+    }, nullptr, &range, &not_banana);
+    BOOST_ASSERT((kept_rows == std::vector<int>{4, 5, 7}));
+    bool missing = false;
+    try {
+        tables.range_by_name("items", "Other");
+    } catch (xlsx::Exception&) {
+        missing = true;
+    }
+    BOOST_ASSERT(missing);
+
+    std::string csv = "\xEF\xBB\xBF" "id,name,,memo\r\n1,\"a,\"\"b\"\"\",,\"x\r\ny\"\n\n2,c";
+    xlsx::CsvReader csv_reader(csv.data(), csv.size(), ',');
+    BOOST_ASSERT(csv_reader.next_row(raw) && raw.index == 0 && raw.size() == 3);
+    BOOST_ASSERT(raw[0].v == "id" && raw[0].t == "inlineStr" && raw[2].col == 3);
+    BOOST_ASSERT(csv_reader.next_row(raw) && raw.index == 1 && raw.size() == 3);
+    BOOST_ASSERT(raw[0].v == "1" && raw[0].t.empty());
+    BOOST_ASSERT(raw[1].v == "a,\"b\"" && raw[2].col == 3 && raw[2].v == "x\r\ny");
+    BOOST_ASSERT(csv_reader.next_row(raw) && raw.index == 2 && raw.size() == 0);
+    BOOST_ASSERT(csv_reader.next_row(raw) && raw.index == 3 && raw[1].v == "c");
+    BOOST_ASSERT(!csv_reader.next_row(raw) && csv_reader.done);
+    xlsx::CellRange::parse("B2:C2", range);
+    xlsx::CsvReader csv_bounded(csv.data(), csv.size(), ',');
+    csv_bounded.bounds = &range;
+    BOOST_ASSERT(csv_bounded.next_row(raw) && raw.index == 1 && raw.size() == 1);
+    BOOST_ASSERT(raw[0].col == 1 && raw[0].v == "a,\"b\"");
+    BOOST_ASSERT(!csv_bounded.next_row(raw));
+    // a record wider than a sheet is an error, not cut at the last column.
+    std::string wide_csv = "a\n" + std::string(xlsx::CsvReader::kMaxCols, ',') + "x\n";
+    xlsx::CsvReader csv_wide(wide_csv.data(), wide_csv.size(), ',');
+    BOOST_ASSERT(csv_wide.next_row(raw) && raw.size() == 1);
+    std::string wide_message;
+    try {
+        csv_wide.next_row(raw);
+    } catch (xlsx::Exception& exc) {
+        wide_message = exc.what();
+    }
+    BOOST_ASSERT(wide_message.find("too many fields. row=2") != std::string::npos);
+    std::string fit = std::string(xlsx::CsvReader::kMaxCols - 1, ',') + "x";
+    xlsx::CsvReader csv_fit(fit.data(), fit.size(), ',');
+    xlsx::Sheet fit_sheet("rid", "", csv_fit, nullptr, nullptr);
+    BOOST_ASSERT(fit_sheet.ncols() == xlsx::CsvReader::kMaxCols);
+    BOOST_ASSERT(fit_sheet.cell("XFD1").as_str() == "x");
+
+    xlsx::Workbook::Options tsv_options;
+    tsv_options.delimiter = '\t';
+    xlsx::Workbook tsv("tests/xlsx/items.tsv", tsv_options);
+    auto& tsv_sheet = tsv.sheet_by_name("");
+    BOOST_ASSERT(tsv_sheet.nrows() == 3 && tsv_sheet.cell("B3").as_str() == "tab\tbed");
+    BOOST_ASSERT(tsv_sheet.cell("C2").as_double() == 1.5);
+    int tsv_rows = 0;
+    tsv.each_row("", [&](xlsx::Row& row) {
+        BOOST_ASSERT(row.cell(0).as_str() == tsv_sheet.cell(row.index, 0).as_str());
+        ++tsv_rows;
+    });
+    BOOST_ASSERT(tsv_rows == 3);
+
     return 0;
 }